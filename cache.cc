@@ -3,18 +3,24 @@
 #include <string.h>
 #include <cmath>
 #include <iostream>
+#include <algorithm>
 
 #include "cache.h"
+#include "instrument.h"
 
 void Cache::init(config_t config, protocol_t protocol, bus_t* bus) {
     this->bus = bus;
     this->protocol = protocol;
+    verbose = false;
+    measured_misses = false;
 
     stats.hits = 0;
     stats.misses = 0;
     stats.accesses = 0;
     stats.miss_rate = 0;
     stats.writebacks = 0;
+    stats.victim_hits = 0;
+    stats.miss_cycles = 0;
     stats.amat = 0;
     stats.traffic = 0;
     stats.data_accesses = 0;
@@ -50,6 +56,17 @@ void Cache::init(config_t config, protocol_t protocol, bus_t* bus) {
             cache[i].blocks[j].state = INVALID;
         }
     }
+
+    victims.size = config.victim_entries;
+    victims.stack = victims.size ? new Cache::LruStack(victims.size) : NULL;
+    victims.blocks = new cache_block_t[victims.size];
+    for (unsigned int i = 0; i < victims.size; i++) {
+        victims.blocks[i].tag = 0;
+        victims.blocks[i].dirty = 0;
+        victims.blocks[i].valid = 0;
+        victims.blocks[i].data = new uint8_t[block_size];
+        victims.blocks[i].state = INVALID;
+    }
 }
 
 Cache::~Cache() {
@@ -61,6 +78,11 @@ Cache::~Cache() {
         delete [] cache[i].blocks;
     }
     delete [] cache;
+    delete victims.stack;
+    for (unsigned int i = 0; i < victims.size; i++) {
+        delete [] victims.blocks[i].data;
+    }
+    delete [] victims.blocks;
 }
 
 Cache::addr_split_t Cache::split_address(addr_t physical_addr) {
@@ -72,7 +94,7 @@ Cache::addr_split_t Cache::split_address(addr_t physical_addr) {
     return split;
 }
 
-uint8_t Cache::processor_access(addr_t physical_addr, access_t access_type, uint8_t data) {
+void Cache::processor_access(addr_t physical_addr, access_t access_type, uint8_t* data, unsigned int size) {
 
     addr_split_t addr = split_address(physical_addr);
 
@@ -81,23 +103,15 @@ uint8_t Cache::processor_access(addr_t physical_addr, access_t access_type, uint
     // if (access_type == IFETCH) stats.instr_accesses++;
     // if (access_type == MEMWRITE || access_type == MEMREAD) stats.data_accesses++;
 
-    uint8_t result = 0;
-
     for (unsigned int way = 0; way < ways; way++) {
         if (cache[addr.index].blocks[way].tag == addr.tag && cache[addr.index].blocks[way].valid) { // hit
             // stats.hits++;
-            if (access_type == MEMWRITE) {
-                cache[addr.index].blocks[way].dirty = 1;
-                cache[addr.index].blocks[way].data[addr.offset] = data;
-            } 
-            // printf("access %d %d %llx\n", index, way, cache[index].blocks[way].data);
-            result = cache[addr.index].blocks[way].data[addr.offset];
+            perform(&cache[addr.index].blocks[way], addr.offset, access_type, data, size);
             // Update LRU stack
             cache[addr.index].stack->set_mru(way);
             break;
         }
     }
-    return result;
 }
 
 bool Cache::system_access(addr_t physical_addr, access_t access_type) {
@@ -107,20 +121,30 @@ bool Cache::system_access(addr_t physical_addr, access_t access_type) {
     if (access_type == SEND) {
         // Find cache block and copy its data to bus
         for (unsigned int way = 0; way < ways; way++) {
-            if (cache[addr.index].blocks[way].tag == addr.tag && cache[addr.index].blocks[way].valid && cache[addr.index].blocks[way].dirty) { // hit, will only send if dirty
+            if (cache[addr.index].blocks[way].tag == addr.tag && cache[addr.index].blocks[way].valid) {
+                // clean copies snoop the request too (EXCLUSIVE -> SHARED on a read miss), but only dirty ones send data
+                transition_bus(&cache[addr.index].blocks[way], bus->message);
+                if (!cache[addr.index].blocks[way].dirty) return false;
                 // cache[addr.index].blocks[way].dirty = 0; // now is shared, and memory will be updated
-                // cache[index].blocks[way].state = SHARED;
-                transition_bus(&cache[addr.index].blocks[way], bus->message); 
                 memcpy(bus->data, cache[addr.index].blocks[way].data, sizeof(uint8_t) * block_size);
+                stats.traffic += block_size;
                 return true;
             } 
         }
+        int slot = victims.size ? find_victim(physical_addr) : -1;
+        if (slot >= 0) {
+            transition_bus(&victims.blocks[slot], bus->message);
+            if (!victims.blocks[slot].dirty) return false;
+            memcpy(bus->data, victims.blocks[slot].data, sizeof(uint8_t) * block_size);
+            stats.traffic += block_size;
+            return true;
+        }
         return false; // Not found; don't do anything
     }
 
     if (access_type == STORE) {
         // Check if there is an empty way and if so, use first one
-        unsigned int accessed_way;
+        unsigned int accessed_way = 0;
         bool found_empty = false;
         for (unsigned int way = 0; way < ways; way++) {
             if (!cache[addr.index].blocks[way].valid) {
@@ -129,16 +153,13 @@ bool Cache::system_access(addr_t physical_addr, access_t access_type) {
                 break;
             }
         }
-        // No empty way. Use LRU
+        // No empty way. Use LRU (normally already evicted by try_access)
         if (!found_empty) {
             accessed_way = cache[addr.index].stack->get_lru();
-            // write back old data in block if dirty
-            if (cache[addr.index].blocks[accessed_way].dirty) {
-                stats.writebacks++;
-            }
         }
         
         memcpy(cache[addr.index].blocks[accessed_way].data, bus->data, sizeof(uint8_t) * block_size);
+        stats.traffic += block_size;
         cache[addr.index].blocks[accessed_way].valid = 1;
         cache[addr.index].blocks[accessed_way].dirty = 0;
         cache[addr.index].blocks[accessed_way].tag = addr.tag;
@@ -148,29 +169,25 @@ bool Cache::system_access(addr_t physical_addr, access_t access_type) {
     return false;
 }
 
-uint8_t Cache::try_access(addr_t physical_addr, access_t access_type, uint8_t data) {
+void Cache::try_access(addr_t physical_addr, access_t access_type, uint8_t* data, unsigned int size) {
+    INSTRUMENT_SCOPE(PHASE_CACHE);
     stats.accesses++;
     if (access_type == IFETCH) stats.instr_accesses++;
-    if (access_type == MEMWRITE || access_type == MEMREAD) stats.data_accesses++;
+    if (access_type != IFETCH) stats.data_accesses++;
 
     addr_split_t addr = split_address(physical_addr);
 
-    uint8_t result = 0;
     int hit = 0;
 
     // Check if valid block exists
-    unsigned int empty_way;
+    unsigned int empty_way = 0;
     bool found_empty = false;
     for (unsigned int way = 0; way < ways; way++) {
         if (cache[addr.index].blocks[way].tag == addr.tag && cache[addr.index].blocks[way].valid) { // hit
             stats.hits++;
             hit = 1;
-            if (access_type == MEMWRITE) {
-                cache[addr.index].blocks[way].dirty = 1;
-                cache[addr.index].blocks[way].data[addr.offset] = data;
-            }
+            perform(&cache[addr.index].blocks[way], addr.offset, access_type, data, size);
             transition_processor(&cache[addr.index].blocks[way], access_type);
-            result = cache[addr.index].blocks[way].data[addr.offset];
             break;
         }
         if (!found_empty && !cache[addr.index].blocks[way].valid) {
@@ -181,14 +198,90 @@ uint8_t Cache::try_access(addr_t physical_addr, access_t access_type, uint8_t da
     if (!hit) { // miss
         stats.misses++;
         if (access_type == IFETCH) stats.instr_misses++;
-        if (access_type == MEMWRITE || access_type == MEMREAD) stats.data_misses++;
-        transition_processor(
-            found_empty ? &cache[addr.index].blocks[empty_way] : &cache[addr.index].blocks[cache[addr.index].stack->get_lru()],
-            access_type
-        );
+        if (access_type != IFETCH) stats.data_misses++;
+        unsigned int victim_way = found_empty ? empty_way : cache[addr.index].stack->get_lru();
+        int slot = victims.size ? find_victim(physical_addr) : -1;
+        if (slot >= 0) {
+            // Still held in the victim cache: swap it back into the set and finish as a hit
+            stats.victim_hits++;
+            swap_with_victim(addr.index, victim_way, (unsigned int) slot, addr.tag);
+            cache[addr.index].stack->set_mru(victim_way);
+            perform(&cache[addr.index].blocks[victim_way], addr.offset, access_type, data, size);
+            transition_processor(&cache[addr.index].blocks[victim_way], access_type);
+            return;
+        }
+        if (!measured_misses) stats.miss_cycles += (counter_t) miss_penalty;
+        // Make room for the incoming block before the coherence transaction starts
+        if (!found_empty) {
+            if (victims.size) {
+                move_to_victims(addr.index, victim_way);
+            } else {
+                evict(&cache[addr.index].blocks[victim_way],
+                        ((addr_t) cache[addr.index].blocks[victim_way].tag << (num_index_bits + num_offset_bits)) | ((addr_t) addr.index << num_offset_bits));
+            }
+        }
+        transition_processor(&cache[addr.index].blocks[victim_way], access_type);
     }
+}
 
-    return result;
+bool Cache::try_hit(addr_t physical_addr, access_t access_type, uint8_t* data, unsigned int size) {
+    INSTRUMENT_SCOPE(PHASE_CACHE);
+    addr_split_t addr = split_address(physical_addr);
+    for (unsigned int way = 0; way < ways; way++) {
+        cache_block_t* block = &cache[addr.index].blocks[way];
+        if (block->tag == addr.tag && block->valid) {
+            // A snooped SEND leaves a copy INVALID but still valid until the requester's transaction
+            // invalidates it, and that transaction holds the bus
+            if (block->state == INVALID) return false;
+            if (access_type == MEMWRITE && block->state != MODIFIED && block->state != EXCLUSIVE) {
+                return false; // needs an upgrade
+            }
+            stats.accesses++;
+            if (access_type == IFETCH) stats.instr_accesses++;
+            if (access_type != IFETCH) stats.data_accesses++;
+            stats.hits++;
+            perform(block, addr.offset, access_type, data, size);
+            // The only transition a hit can make without the bus; transition_processor may post a message
+            if (access_type == MEMWRITE && block->state == EXCLUSIVE) {
+                block->state = MODIFIED;
+                if (verbose) {
+                    std::cout << "    Cache block " << block << " state: " << EXCLUSIVE << " -> " << MODIFIED << "\n";
+                }
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void Cache::perform(cache_block_t* cache_block, unsigned int offset, access_t access_type, uint8_t* data, unsigned int size) {
+    uint8_t* line_data = cache_block->data + offset;
+    if (access_type == MEMWRITE) {
+        cache_block->dirty = 1;
+        memcpy(line_data, data, size);
+    } else if (is_rmw(access_type)) {
+        // data holds the operand; return the old value in its place
+        uint8_t old_data[MAX_RMW_SIZE];
+        memcpy(old_data, line_data, size);
+        if (access_type == ATOMIC_SWAP) {
+            memcpy(line_data, data, size);
+        } else if (access_type == ATOMIC_FETCH_ADD) {
+            // little endian add, carry discarded past the access size
+            unsigned int carry = 0;
+            for (unsigned int i = 0; i < size; i++) {
+                unsigned int sum = old_data[i] + data[i] + carry;
+                line_data[i] = (uint8_t) sum;
+                carry = sum >> 8;
+            }
+        } else if (memcmp(old_data, data + size, size) == 0) { // ATOMIC_CAS, compare value follows the new value
+            memcpy(line_data, data, size);
+        }
+        // the line is written (held in MODIFIED) whether or not a compare-and-swap succeeds
+        cache_block->dirty = 1;
+        memcpy(data, old_data, size);
+    } else {
+        memcpy(data, line_data, size);
+    }
 }
 
 Cache::add_result_t Cache::add_block(addr_t physical_addr, access_t access_type) {
@@ -197,7 +290,7 @@ Cache::add_result_t Cache::add_block(addr_t physical_addr, access_t access_type)
     unsigned int accessed_way;
 
     // Check if there is an empty way
-    unsigned int empty_way;
+    unsigned int empty_way = 0;
     bool found_empty = false;
     for (unsigned int way = 0; way < ways; way++) {
         if (!cache[addr.index].blocks[way].valid) {
@@ -246,6 +339,61 @@ Cache::add_result_t Cache::add_block(addr_t physical_addr, access_t access_type)
     return result;
 }
 
+void Cache::evict(cache_block_t* block, addr_t block_addr) {
+    bus->evicted = true;
+    bus->evicted_addr = block_addr;
+    bus->evicted_dirty = block->dirty;
+    if (block->dirty) {
+        // put old data on the bus so the system can write it back to memory
+        memcpy(bus->data, block->data, sizeof(uint8_t) * block_size);
+        stats.writebacks++;
+        stats.traffic += block_size;
+    }
+    block->valid = 0;
+    block->dirty = 0;
+    block->state = INVALID;
+}
+
+int Cache::find_victim(addr_t physical_addr) {
+    unsigned int line = (unsigned int) (physical_addr >> num_offset_bits);
+    for (unsigned int i = 0; i < victims.size; i++) {
+        if (victims.blocks[i].tag == line && victims.blocks[i].valid) {
+            return (int) i;
+        }
+    }
+    return -1;
+}
+
+void Cache::move_to_victims(unsigned int index, unsigned int way) {
+    // Use a free entry if there is one, otherwise the LRU entry leaves the cache for good
+    unsigned int slot = victims.size;
+    for (unsigned int i = 0; i < victims.size; i++) {
+        if (!victims.blocks[i].valid) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot == victims.size) {
+        slot = victims.stack->get_lru();
+        evict(&victims.blocks[slot], (addr_t) victims.blocks[slot].tag << num_offset_bits);
+    }
+    // The set's way gets the now invalid entry, the entry gets the block with its state, dirty bit and data
+    unsigned int line = (cache[index].blocks[way].tag << num_index_bits) | index;
+    std::swap(cache[index].blocks[way], victims.blocks[slot]);
+    victims.blocks[slot].tag = line;
+    victims.stack->set_mru(slot);
+}
+
+void Cache::swap_with_victim(unsigned int index, unsigned int way, unsigned int slot, unsigned int tag) {
+    unsigned int displaced_line = (cache[index].blocks[way].tag << num_index_bits) | index;
+    std::swap(cache[index].blocks[way], victims.blocks[slot]);
+    cache[index].blocks[way].tag = tag;
+    if (victims.blocks[slot].valid) {
+        victims.blocks[slot].tag = displaced_line;
+        victims.stack->set_mru(slot);
+    }
+}
+
 bool Cache::invalidate(addr_t evicted_addr) {
     addr_split_t addr = split_address(evicted_addr);
     
@@ -253,12 +401,18 @@ bool Cache::invalidate(addr_t evicted_addr) {
         if (cache[addr.index].blocks[way].tag == addr.tag && cache[addr.index].blocks[way].valid) { // found block
             cache[addr.index].blocks[way].valid = 0;
             transition_bus(&cache[addr.index].blocks[way], INVALIDATE);
-            if (cache[addr.index].blocks[way].dirty) {
-                return true;
-            }
-            return false;
+            // every protocol state ends here; a stale state would be picked up by the next fill of this way
+            cache[addr.index].blocks[way].state = INVALID;
+            return true;
         }
     }
+    int slot = victims.size ? find_victim(evicted_addr) : -1;
+    if (slot >= 0) {
+        victims.blocks[slot].valid = 0;
+        transition_bus(&victims.blocks[slot], INVALIDATE);
+        victims.blocks[slot].state = INVALID;
+        return true;
+    }
     return false;
 }
 
@@ -270,7 +424,25 @@ bool Cache::check_valid(addr_t physical_addr) {
             return true;
         }
     }
-    return false;
+    return victims.size && find_victim(physical_addr) >= 0;
+}
+
+bool Cache::probe(addr_t physical_addr, line_copy_t* copy) {
+    addr_split_t addr = split_address(physical_addr);
+    cache_block_t* block = NULL;
+    for (unsigned int way = 0; way < ways; way++) {
+        if (cache[addr.index].blocks[way].tag == addr.tag && cache[addr.index].blocks[way].valid) {
+            block = &cache[addr.index].blocks[way];
+            break;
+        }
+    }
+    int slot = !block && victims.size ? find_victim(physical_addr) : -1;
+    if (slot >= 0) block = &victims.blocks[slot];
+    if (!block) return false;
+    copy->state = block->state;
+    copy->dirty = block->dirty;
+    copy->data = block->data;
+    return true;
 }
 
 void Cache::transition_bus(cache_block_t* cache_block, message_t bus_message) {
@@ -309,7 +481,7 @@ void Cache::transition_bus(cache_block_t* cache_block, message_t bus_message) {
                 case EXCLUSIVE:
                     if (bus_message == READ_MISS) {
                         cache_block->state = SHARED;
-                    } else if (bus_message == WRITE_MISS) {
+                    } else if (bus_message == WRITE_MISS || bus_message == INVALIDATE) {
                         cache_block->state = INVALID;
                     }
                     break;
@@ -343,6 +515,8 @@ void Cache::transition_bus(cache_block_t* cache_block, message_t bus_message) {
 
 void Cache::transition_processor(cache_block_t* cache_block, access_t request) {
     state_t old_state = cache_block->state;
+    // Atomics need the line exclusively, the same as a write
+    if (is_rmw(request)) request = MEMWRITE;
     switch (protocol) {
         case MSI:
             switch (cache_block->state) {
@@ -371,7 +545,7 @@ void Cache::transition_processor(cache_block_t* cache_block, access_t request) {
                     if (request == MEMWRITE) {
                         cache_block->state = MODIFIED;
                         bus->message = WRITE_MISS;
-                    } else if (request == MEMREAD) {
+                    } else if (request == MEMREAD || request == IFETCH) {
                         bus->message = READ_MISS;
                         // special case: pass handling back to system before changing state.
                         // see if other caches have block to determine whether to move to exclusive or shared state
@@ -403,9 +577,16 @@ void Cache::transition_processor(cache_block_t* cache_block, access_t request) {
 void Cache::print_stats() {
     get_stats();
     printf( "%d-byte %d-way set associative cache with %d-byte lines\n"
-            "Hit time: %d cycles\n"
-            "Miss penalty: %d cycles\n"
-            "--------------------------------------------------------------------\n"
+            "Hit time: %d cycles\n",
+            cache_size, ways, block_size,
+            hit_time);
+    if (measured_misses) {
+        counter_t charged = stats.misses - stats.victim_hits;
+        printf("Miss latency: %f cycles average\n", charged ? (1.0 * stats.miss_cycles) / charged : 0.0);
+    } else {
+        printf("Miss penalty: %d cycles\n", miss_penalty);
+    }
+    printf( "--------------------------------------------------------------------\n"
             "Accesses: %llu\n"
             "Hits: %llu\n"
             "Misses: %llu\n" 
@@ -413,11 +594,8 @@ void Cache::print_stats() {
             "    Instruction miss rate: %f%%\n"
             "    Data miss rate: %f%%\n"
             "AMAT: %f cycles\n"
-            "Writebacks: %llu\n\n",  
-            cache_size, ways, block_size, 
-            hit_time, 
-            miss_penalty,
-
+            "Writebacks: %llu\n"
+            "Bus traffic: %llu bytes\n",  
             stats.accesses, 
             stats.hits, 
             stats.misses, 
@@ -425,12 +603,23 @@ void Cache::print_stats() {
             (1.0 * stats.instr_misses) / stats.instr_accesses * 100,
             (1.0 * stats.data_misses) / stats.data_accesses * 100,
             stats.amat,
-            stats.writebacks);  
+            stats.writebacks,
+            stats.traffic);  
+    if (victims.size) {
+        printf("Victim cache: %u entries\n"
+                "    Hits: %llu (%f%% of misses recovered)\n"
+                "    Miss rate with victim cache: %f%%\n",
+                victims.size,
+                stats.victim_hits, stats.misses ? (100.0 * stats.victim_hits) / stats.misses : 0.0,
+                stats.accesses ? (100.0 * (stats.misses - stats.victim_hits)) / stats.accesses : 0.0);
+    }
+    printf("\n");
 }
 
 stats_t* Cache::get_stats() {
     stats.miss_rate = (1.0 * stats.misses) / stats.accesses;
-    stats.amat = hit_time + (stats.miss_rate * miss_penalty);
+    // misses caught by the victim cache never reach the bus, so they aren't charged miss cycles
+    stats.amat = hit_time + (1.0 * stats.miss_cycles) / stats.accesses;
     return &stats;
 }
 
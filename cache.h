@@ -1,6 +1,8 @@
 #ifndef __CACHE_H
 #define __CACHE_H
 
+#include <iostream>
+
 #include "global_types.h"
 
 
@@ -16,8 +18,9 @@ typedef enum {
     OWNED
 } state_t;
 
+static const char* const state_names[] = {"INVALID", "SHARED", "MODIFIED", "EXCLUSIVE", "OWNED"};
+
 inline std::ostream& operator<<(std::ostream& os, const state_t state) {
-    const std::string state_names[] = {"INVALID", "SHARED", "MODIFIED", "EXCLUSIVE", "OWNED"};
     return os << state_names[state];
 }
 
@@ -31,6 +34,8 @@ typedef struct stats_t {
 	double miss_rate;
 	counter_t traffic;
 	counter_t writebacks;
+	counter_t victim_hits;     // misses served by the victim cache
+	counter_t miss_cycles;     // cycles spent waiting on misses, see Cache::add_miss_cycles
 	double amat;
 	counter_t data_accesses;
     counter_t data_misses;
@@ -41,6 +46,15 @@ typedef struct stats_t {
     int miss_penalty;
 } stats_t;
 
+/**
+ * A cache's copy of a line, as seen by Cache::probe
+*/
+typedef struct line_copy_t {
+    state_t state;
+    bool dirty;
+    const uint8_t* data;    // the whole line
+} line_copy_t;
+
 class Cache {
     private:
         // Private types
@@ -77,10 +91,13 @@ class Cache {
         unsigned int num_index_bits;     // Number of index bits. 
         int hit_time;
         int miss_penalty;
+        bool measured_misses;   // misses cost whatever add_miss_cycles says, not miss_penalty
         cache_set_t* cache;		// Array of cache sets representing the cache.
+        cache_set_t victims;    // Fully associative victim cache, tags are line numbers. size 0 if disabled
         int cache_type;
         bus_t* bus;
         protocol_t protocol;
+        bool verbose;       // print state changes
 
         // Private methods
         // Transition invoked by message snooped from bus
@@ -89,6 +106,14 @@ class Cache {
         void transition_processor(cache_block_t* cache_block, access_t processor_message);
 
         addr_split_t split_address(addr_t physical_addr);
+        // Remove a valid block to make room for a miss, putting it on the bus for writeback if dirty
+        void evict(cache_block_t* cache_block, addr_t block_addr);
+        // Victim cache: lookup by address (-1 if absent), and moving blocks between it and a set
+        int find_victim(addr_t physical_addr);
+        void move_to_victims(unsigned int index, unsigned int way);
+        void swap_with_victim(unsigned int index, unsigned int way, unsigned int slot, unsigned int tag);
+        // Perform the data part of a processor access on a block holding the line
+        void perform(cache_block_t* cache_block, unsigned int offset, access_t access_type, uint8_t* data, unsigned int size);
 
     public:
         // Public types
@@ -99,6 +124,7 @@ class Cache {
             int hit_time;
             int miss_penalty;
             int cache_type;
+            unsigned int victim_entries;    // 0 for no victim cache
         } config_t;
         
         typedef struct add_result_t {
@@ -110,15 +136,32 @@ class Cache {
         // Public methods
         // Cache(int _block_size, int _cache_size, int _ways, int _hit_time, int _miss_penalty);
         void init(config_t config, protocol_t protocol, bus_t* bus);
+        void set_verbose(bool verbose) { this->verbose = verbose; }
         ~Cache();
         
-        uint8_t processor_access(addr_t physical_addr, access_t access_type, uint8_t data);
+        // Accesses cover size bytes of a single line starting at physical_addr. Reads fill data, writes copy
+        // data into the line.
+        void processor_access(addr_t physical_addr, access_t access_type, uint8_t* data, unsigned int size);
         bool system_access(addr_t physical_addr, access_t access_type);
 
-        uint8_t try_access(addr_t physical_addr, access_t access_type, uint8_t data);
+        void try_access(addr_t physical_addr, access_t access_type, uint8_t* data, unsigned int size);
+        // Perform the access only if it hits and needs nothing from the bus: a read of a SHARED, EXCLUSIVE
+        // or MODIFIED line, or a write to a MODIFIED or EXCLUSIVE one. Never touches the bus. Returns false,
+        // without counting the access, otherwise.
+        bool try_hit(addr_t physical_addr, access_t access_type, uint8_t* data, unsigned int size);
         add_result_t add_block(addr_t physical_addr, access_t access_type);
-        bool invalidate(addr_t evicted_addr);
+        bool invalidate(addr_t evicted_addr); // returns true if a valid copy was invalidated
         bool check_valid(addr_t physical_addr);
+        // Look at the valid block holding the line, if any, without touching LRU, stats or state
+        bool probe(addr_t physical_addr, line_copy_t* copy);
+
+        // Misses not served by the victim cache cost miss_penalty, unless after measure_misses() the
+        // system charges each one what it took with add_miss_cycles
+        void measure_misses() { measured_misses = true; }
+        void add_miss_cycles(counter_t cycles) { stats.miss_cycles += cycles; }
+        int get_miss_penalty() { return miss_penalty; }
+        // The core's clock: hit_time per access plus the cycles spent on misses
+        counter_t get_cycles() { return stats.accesses * (counter_t) hit_time + stats.miss_cycles; }
 
         void print_stats();
         stats_t* get_stats();
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "checker.h"
+
+CoherenceChecker::CoherenceChecker(unsigned int line_size) {
+    this->line_size = line_size;
+    checked_accesses = 0;
+    checked_lines = 0;
+    violations = 0;
+    first_wrapped_access = 0;
+}
+
+std::vector<uint8_t>& CoherenceChecker::golden_line(addr_t physical_addr) {
+    std::vector<uint8_t>& line = golden[physical_addr & ~((addr_t) line_size - 1)];
+    if (line.empty()) line.assign(line_size, 0);
+    return line;
+}
+
+void CoherenceChecker::report(addr_t physical_addr, const char* format, ...) {
+    violations++;
+    if (violations > MAX_REPORTS) return;
+    printf("COHERENCE VIOLATION (line 0x%llx): ", physical_addr & ~((addr_t) line_size - 1));
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    printf("\n");
+}
+
+void CoherenceChecker::check_access(unsigned int core, addr_t physical_addr, access_t access_type,
+        const uint8_t* operand, const uint8_t* result, unsigned int size) {
+    checked_accesses++;
+    if (first_wrapped_access) return;
+    uint8_t* golden_data = &golden_line(physical_addr)[physical_addr & (line_size - 1)];
+    if (access_type == MEMWRITE) {
+        memcpy(golden_data, operand, size);
+        return;
+    }
+    if (memcmp(result, golden_data, size) != 0) {
+        report(physical_addr, "core %u %s of %u bytes at 0x%llx returned stale data", core,
+                is_rmw(access_type) ? "atomic" : "read", size, physical_addr);
+    }
+    if (access_type == ATOMIC_SWAP) {
+        memcpy(golden_data, operand, size);
+    } else if (access_type == ATOMIC_FETCH_ADD) {
+        unsigned int carry = 0;
+        for (unsigned int i = 0; i < size; i++) {
+            unsigned int sum = golden_data[i] + operand[i] + carry;
+            golden_data[i] = (uint8_t) sum;
+            carry = sum >> 8;
+        }
+    } else if (access_type == ATOMIC_CAS && memcmp(golden_data, operand + size, size) == 0) {
+        memcpy(golden_data, operand, size);
+    }
+}
+
+void CoherenceChecker::check_line(addr_t physical_addr, int requester, const line_copy_t* copies, const bool* held,
+        unsigned int num_caches, const uint8_t* memory, const uint8_t* const* llc_copies,
+        unsigned int num_llcs, const uint64_t* filtered) {
+    checked_lines++;
+    const uint8_t* golden_data = &golden_line(physical_addr)[0];
+    unsigned int writers = 0;   // copies in MODIFIED or EXCLUSIVE
+    unsigned int readers = 0;   // copies in SHARED
+    bool dirty = false;
+    if (requester >= 0 && (!held[requester] || copies[requester].state == INVALID)) {
+        report(physical_addr, "cache %d accessed the line but does not hold it", requester);
+    }
+    for (unsigned int i = 0; i < num_caches; i++) {
+        if (!held[i]) continue;
+        if (copies[i].state == INVALID) {
+            report(physical_addr, "cache %u has a valid block in INVALID state", i);
+            continue;
+        }
+        if (copies[i].state == MODIFIED || copies[i].state == EXCLUSIVE) writers++;
+        else readers++;
+        if (copies[i].dirty) dirty = true;
+        if (!first_wrapped_access && memcmp(copies[i].data, golden_data, line_size) != 0) {
+            report(physical_addr, "cache %u holds stale data in state %s", i, state_names[copies[i].state]);
+        }
+        if (filtered && !(*filtered >> i & 1)) {
+            report(physical_addr, "cache %u holds the line but the snoop filter does not list it", i);
+        }
+    }
+    if (writers > 1 || (writers == 1 && readers > 0)) {
+        report(physical_addr, "%u exclusive and %u shared copies", writers, readers);
+    }
+    if (first_wrapped_access || dirty) return;
+    if (memcmp(memory, golden_data, line_size) != 0) {
+        report(physical_addr, "no cache holds the line dirty but memory is stale");
+    }
+    for (unsigned int i = 0; i < num_llcs; i++) {
+        if (llc_copies[i] && memcmp(llc_copies[i], golden_data, line_size) != 0) {
+            report(physical_addr, "no cache holds the line dirty but socket %u's LLC copy is stale", i);
+        }
+    }
+}
+
+void CoherenceChecker::print_stats() {
+    printf("Coherence check: %llu accesses, %llu line states checked, %llu violations%s\n",
+            checked_accesses, checked_lines, violations,
+            violations > MAX_REPORTS ? " (only the first ones printed)" : "");
+    if (first_wrapped_access) {
+        printf("    Data values only checked for the first %llu accesses; access %llu was past the end of memory\n",
+                first_wrapped_access - 1, first_wrapped_access);
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef __CHECKER_H
+#define __CHECKER_H
+
+#include <inttypes.h>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include "cache.h"
+#include "global_types.h"
+
+/**
+ * Coherence checker fed by System after every access that reaches a cache. It keeps a
+ * golden flat memory updated in access order, independently of the caches, and checks:
+ *
+ * - reads and the old values returned by atomics match the golden memory,
+ * - the requesting cache ends up holding the line,
+ * - single writer / multiple readers: a MODIFIED or EXCLUSIVE copy is the only valid one,
+ * - no cache keeps a valid block in INVALID state,
+ * - every valid copy holds the golden data, and memory and the LLCs' copies do too when no
+ *   private copy is dirty,
+ * - the snoop filter lists every cache that holds the line.
+ *
+ * With store buffers, stores are checked when they drain to the cache and forwarded loads
+ * are not checked, since under TSO they may see the core's own stores before other cores do.
+ * Addresses past the end of memory wrap around onto other lines, which the caches hold as
+ * separate copies, so data checks stop at the first such access; state checks go on.
+ */
+class CoherenceChecker {
+    private:
+        static const unsigned int MAX_REPORTS = 20;   // violations printed; the rest are only counted
+
+        unsigned int line_size;
+        std::unordered_map<addr_t, std::vector<uint8_t> > golden; // line address -> data; lines never written are zero
+        counter_t checked_accesses;
+        counter_t checked_lines;
+        counter_t violations;
+        counter_t first_wrapped_access; // number of the first access past the end of memory (from 1), 0 if none
+
+        std::vector<uint8_t>& golden_line(addr_t physical_addr);
+        void report(addr_t physical_addr, const char* format, ...);
+
+    public:
+        CoherenceChecker(unsigned int line_size);
+        // Perform a single-line access on the golden memory. operand is data as passed to the access
+        // (atomics: the operand(s)), result is data after it (reads and atomics: the value returned).
+        void check_access(unsigned int core, addr_t physical_addr, access_t access_type,
+                const uint8_t* operand, const uint8_t* result, unsigned int size);
+        // Check every cache's copy of a line. held[i] tells whether copies[i] is valid. requester is the
+        // cache that just accessed the line, or -1. memory is the line in main memory (or a dirty LLC
+        // copy, which is newer). llc_copies[i] is socket i's LLC copy, NULL if it has none. filtered is
+        // the snoop filter's sharer mask, or NULL without a snoop filter.
+        void check_line(addr_t physical_addr, int requester, const line_copy_t* copies, const bool* held,
+                unsigned int num_caches, const uint8_t* memory, const uint8_t* const* llc_copies,
+                unsigned int num_llcs, const uint64_t* filtered);
+        // The next access is past the end of memory
+        void note_wrapped_access() { if (!first_wrapped_access) first_wrapped_access = checked_accesses + 1; }
+        counter_t get_violations() { return violations; }
+        void print_stats();
+};
+
+#endif
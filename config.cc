@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <ctype.h>
+#include <algorithm>
+#include <iostream>
+
+#include "config.h"
+
+// section -> key -> value, as read from the file and overrides
+typedef std::map<std::string, std::map<std::string, std::string> > sections_t;
+
+static const char* const system_keys[] = {"cores", "protocol", "memory_size", "bus_width", "sockets", "link_latency", "link_bandwidth", NULL};
+static const char* const cache_keys[] = {"line_size", "size", "associativity", "hit_time", "miss_penalty", "victim_entries", "replacement", "prefetch", NULL};
+static const char* const llc_keys[] = {"size", "associativity", "hit_time", NULL};
+static const char* const store_buffer_keys[] = {"entries", "drain_interval", NULL};
+static const char* const dram_keys[] = {"channels", "banks", "row_size", "page_policy", "t_cas", "t_rcd", "t_rp", "t_burst",
+    "write_queue", "cache_to_cache", NULL};
+
+static std::string trim(const std::string& s) {
+    size_t start = s.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos) return "";
+    size_t end = s.find_last_not_of(" \t\r\n");
+    return s.substr(start, end - start + 1);
+}
+
+static std::string lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    return s;
+}
+
+static bool is_power_of_two(unsigned int n) {
+    return n && !(n & (n - 1));
+}
+
+// Decimal, or hex with an explicit 0x prefix. A leading 0 is not octal.
+static bool parse_uint(const std::string& value, unsigned int* out) {
+    bool hex = value.size() > 2 && value[0] == '0' && (value[1] == 'x' || value[1] == 'X');
+    const char* digits = value.c_str() + (hex ? 2 : 0);
+    if (!isxdigit((unsigned char) digits[0]) || (!hex && !isdigit((unsigned char) digits[0]))) return false;
+    char* end;
+    unsigned long long n = strtoull(digits, &end, hex ? 16 : 10);
+    if (*end != '\0' || n > UINT_MAX) return false;
+    *out = (unsigned int) n;
+    return true;
+}
+
+static std::vector<std::string> split(const std::string& line, char separator) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t end = line.find(separator, start);
+        fields.push_back(trim(line.substr(start, end == std::string::npos ? std::string::npos : end - start)));
+        if (end == std::string::npos) break;
+        start = end + 1;
+    }
+    return fields;
+}
+
+static bool parse_ini(const std::vector<std::string>& lines, sections_t* sections, std::string* error) {
+    std::string section;
+    for (unsigned int i = 0; i < lines.size(); i++) {
+        std::string line = lines[i];
+        size_t comment = line.find_first_of(";#");
+        if (comment != std::string::npos) line = line.substr(0, comment);
+        line = trim(line);
+        if (line.empty()) continue;
+        std::string where = "line " + std::to_string(i + 1) + ": ";
+        if (line[0] == '[') {
+            if (line[line.size() - 1] != ']') {
+                *error = where + "expected [section]";
+                return false;
+            }
+            section = lower(trim(line.substr(1, line.size() - 2)));
+            (*sections)[section];
+            continue;
+        }
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            *error = where + "expected key = value";
+            return false;
+        }
+        if (section.empty()) {
+            *error = where + "key outside of a [section]";
+            return false;
+        }
+        (*sections)[section][lower(trim(line.substr(0, equals)))] = trim(line.substr(equals + 1));
+    }
+    return true;
+}
+
+// Original format: positional lines, translated to the INI keys
+static bool parse_legacy(const std::vector<std::string>& lines, sections_t* sections, std::string* error) {
+    static const char* const line_keys[][9] = {
+        {"system.cores", "system.protocol", NULL},
+        {"cache.line_size", "cache.size", "cache.associativity", "cache.hit_time", "cache.miss_penalty",
+            "cache.victim_entries", "store_buffer.entries", "store_buffer.drain_interval", NULL},
+        {"system.memory_size", "system.bus_width", NULL},
+        {"system.sockets", "system.link_latency", "system.link_bandwidth", NULL},
+    };
+    static const unsigned int required_fields[] = {2, 5, 2, 3};
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < lines.size(); i++) {
+        if (trim(lines[i]).empty()) continue;
+        std::string where = "line " + std::to_string(i + 1) + ": ";
+        if (n == 4) {
+            *error = where + "unexpected extra line";
+            return false;
+        }
+        std::vector<std::string> fields = split(lines[i], ',');
+        unsigned int max_fields = 0;
+        while (line_keys[n][max_fields]) max_fields++;
+        if (fields.size() < required_fields[n] || fields.size() > max_fields) {
+            *error = where + "expected " + std::to_string(required_fields[n]) + " to " + std::to_string(max_fields) + " comma separated fields";
+            return false;
+        }
+        for (unsigned int f = 0; f < fields.size(); f++) {
+            std::string key = line_keys[n][f];
+            size_t dot = key.find('.');
+            (*sections)[key.substr(0, dot)][key.substr(dot + 1)] = fields[f];
+        }
+        n++;
+    }
+    if (n < 3) {
+        *error = "expected at least 3 lines";
+        return false;
+    }
+    return true;
+}
+
+static bool apply_override(const std::string& override_str, sections_t* sections, std::string* error) {
+    size_t equals = override_str.find('=');
+    std::string name = trim(override_str.substr(0, equals));
+    size_t dot = name.rfind('.');
+    if (equals == std::string::npos || dot == std::string::npos || dot == 0 || dot == name.size() - 1) {
+        *error = "override " + override_str + ": expected section.key=value";
+        return false;
+    }
+    (*sections)[lower(name.substr(0, dot))][lower(name.substr(dot + 1))] = trim(override_str.substr(equals + 1));
+    return true;
+}
+
+static bool known_key(const char* const* keys, const std::string& key) {
+    for (unsigned int i = 0; keys[i]; i++) {
+        if (key == keys[i]) return true;
+    }
+    return false;
+}
+
+// Looks up and converts keys, recording the first error
+class ConfigReader {
+    private:
+        sections_t* sections;
+    public:
+        std::string error;
+
+        ConfigReader(sections_t* sections) : sections(sections) {}
+
+        const std::string* find(const std::string& section, const std::string& key) {
+            sections_t::iterator s = sections->find(section);
+            if (s == sections->end()) return NULL;
+            std::map<std::string, std::string>::iterator k = s->second.find(key);
+            return k == s->second.end() ? NULL : &k->second;
+        }
+
+        // Unsigned value of section.key, or fallback (if not required) when absent
+        unsigned int get(const std::string& section, const std::string& key, bool required, unsigned int fallback) {
+            const std::string* value = find(section, key);
+            unsigned int n = fallback;
+            if (!value) {
+                if (required && error.empty()) error = section + "." + key + ": missing";
+            } else if (!parse_uint(*value, &n) && error.empty()) {
+                error = section + "." + key + ": expected a non-negative integer, got '" + *value + "'";
+            }
+            return n;
+        }
+
+        void fail(const std::string& section, const std::string& key, const std::string& message) {
+            if (error.empty()) error = section + "." + key + ": " + message;
+        }
+};
+
+static bool read_config_file(const char* path, sections_t* sections, std::string* error) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        *error = std::string(path) + ": could not be opened";
+        return false;
+    }
+    std::vector<std::string> lines;
+    char buffer[512];
+    while (fgets(buffer, sizeof(buffer), file)) lines.push_back(buffer);
+    fclose(file);
+
+    // The positional format's first line is "<cores>, <protocol>"
+    bool legacy = false;
+    for (unsigned int i = 0; i < lines.size(); i++) {
+        std::string line = trim(lines[i]);
+        if (line.empty() || line[0] == ';' || line[0] == '#') continue;
+        legacy = line[0] != '[' && line.find('=') == std::string::npos;
+        break;
+    }
+    bool parsed = legacy ? parse_legacy(lines, sections, error) : parse_ini(lines, sections, error);
+    if (!parsed) {
+        *error = std::string(path) + ": " + *error;
+        return false;
+    }
+    return true;
+}
+
+bool load_config(const char* path, const std::vector<std::string>& overrides, system_config_t* config, std::string* error) {
+    sections_t sections;
+    if (path && !read_config_file(path, &sections, error)) return false;
+    for (unsigned int i = 0; i < overrides.size(); i++) {
+        if (!apply_override(overrides[i], &sections, error)) return false;
+    }
+
+    ConfigReader reader(&sections);
+    config->num_cores = reader.get("system", "cores", true, 1);
+    if (reader.error.empty() && config->num_cores == 0) reader.fail("system", "cores", "must be at least 1");
+
+    // Every key must be known, so typos don't silently fall back to defaults
+    for (sections_t::iterator s = sections.begin(); s != sections.end() && reader.error.empty(); s++) {
+        const char* const* keys = NULL;
+        if (s->first == "system") keys = system_keys;
+        else if (s->first == "cache") keys = cache_keys;
+        else if (s->first == "llc") keys = llc_keys;
+        else if (s->first == "store_buffer") keys = store_buffer_keys;
+        else if (s->first == "dram") keys = dram_keys;
+        else if (s->first.compare(0, 5, "core.") == 0) {
+            unsigned int core;
+            if (!parse_uint(s->first.substr(5), &core) || core >= config->num_cores) {
+                *error = "[" + s->first + "]: no such core (cores are numbered from 0 to system.cores - 1)";
+                return false;
+            }
+            keys = cache_keys;
+        } else {
+            *error = "[" + s->first + "]: unknown section; sections are [system], [cache], [core.N], [llc], [store_buffer], [dram]";
+            return false;
+        }
+        for (std::map<std::string, std::string>::iterator k = s->second.begin(); k != s->second.end(); k++) {
+            if (!known_key(keys, k->first)) {
+                *error = s->first + "." + k->first + ": unknown key";
+                return false;
+            }
+        }
+    }
+
+    const std::string* protocol = reader.find("system", "protocol");
+    std::string protocol_name = protocol ? lower(*protocol) : "msi";
+    if (protocol_name == "msi" || protocol_name == "0") config->protocol = MSI;
+    else if (protocol_name == "mesi" || protocol_name == "1") config->protocol = MESI;
+    else reader.fail("system", "protocol", "expected MSI (0) or MESI (1), got '" + *protocol + "'");
+
+    config->caches.clear();
+    for (unsigned int core = 0; core < config->num_cores && reader.error.empty(); core++) {
+        // per-core keys override the shared [cache] section
+        std::string core_section = "core." + std::to_string(core);
+        Cache::config_t cache_config;
+        const char* const* key = cache_keys;
+        std::string source[8];
+        for (unsigned int i = 0; key[i]; i++) {
+            source[i] = reader.find(core_section, key[i]) ? core_section : "cache";
+        }
+        cache_config.cache_type = L1;
+        cache_config.line_size = reader.get(source[0], "line_size", true, 0);
+        cache_config.cache_size = reader.get(source[1], "size", true, 0);
+        cache_config.associativity = reader.get(source[2], "associativity", true, 0);
+        cache_config.hit_time = (int) reader.get(source[3], "hit_time", false, 1);
+        cache_config.miss_penalty = (int) reader.get(source[4], "miss_penalty", false, 100);
+        cache_config.victim_entries = reader.get(source[5], "victim_entries", false, 0);
+        if (!reader.error.empty()) break;
+
+        if (!is_power_of_two(cache_config.line_size)) {
+            reader.fail(source[0], "line_size", "must be a power of two");
+        } else if (core > 0 && cache_config.line_size != config->caches[0].line_size) {
+            reader.fail(source[0], "line_size", "must be the same for every core, since lines move between caches");
+        } else if (cache_config.associativity == 0) {
+            reader.fail(source[2], "associativity", "must be at least 1");
+        } else if (cache_config.cache_size % (cache_config.line_size * cache_config.associativity) != 0
+                || !is_power_of_two(cache_config.cache_size / (cache_config.line_size * cache_config.associativity))) {
+            reader.fail(source[1], "size", "must be line_size * associativity * a power of two number of sets");
+        }
+        // Only one policy of each kind is modeled so far; accept it by name so configs can say so explicitly
+        const std::string* replacement = reader.find(source[6], "replacement");
+        if (replacement && lower(*replacement) != "lru") reader.fail(source[6], "replacement", "only lru is supported");
+        const std::string* prefetch = reader.find(source[7], "prefetch");
+        if (prefetch && lower(*prefetch) != "none") reader.fail(source[7], "prefetch", "only none is supported");
+        config->caches.push_back(cache_config);
+    }
+    if (!reader.error.empty()) {
+        *error = reader.error;
+        return false;
+    }
+    unsigned int line_size = config->caches[0].line_size;
+
+    config->mem_size = reader.get("system", "memory_size", true, 0);
+    config->bus_width = reader.get("system", "bus_width", false, line_size);
+    config->topology.sockets = reader.get("system", "sockets", false, 1);
+    config->topology.link_latency = reader.get("system", "link_latency", false, 0);
+    config->topology.link_bandwidth = reader.get("system", "link_bandwidth", false, 1);
+    config->llc.size = reader.get("llc", "size", false, 0);
+    config->llc.associativity = reader.get("llc", "associativity", false, 16);
+    config->llc.hit_time = reader.get("llc", "hit_time", false, 30);
+    config->store_buffer_entries = reader.get("store_buffer", "entries", false, 0);
+    config->drain_interval = reader.get("store_buffer", "drain_interval", false, 4);
+    if (reader.error.empty()) {
+        if (config->mem_size == 0 || config->mem_size % line_size != 0) {
+            reader.fail("system", "memory_size", "must be a nonzero multiple of the line size");
+        } else if (config->bus_width == 0) {
+            reader.fail("system", "bus_width", "must be at least 1");
+        } else if (config->topology.sockets == 0 || config->topology.sockets > 64 || config->num_cores % config->topology.sockets != 0
+                || (config->mem_size / config->topology.sockets) % line_size != 0) {
+            reader.fail("system", "sockets", "cores and memory must divide evenly into 1-64 sockets");
+        } else if (config->topology.link_bandwidth == 0) {
+            reader.fail("system", "link_bandwidth", "must be at least 1");
+        } else if (config->llc.size > 0 && config->llc.associativity == 0) {
+            reader.fail("llc", "associativity", "must be at least 1");
+        } else if (config->llc.size > 0 && (config->llc.size % (line_size * config->llc.associativity) != 0
+                || !is_power_of_two(config->llc.size / (line_size * config->llc.associativity)))) {
+            reader.fail("llc", "size", "must be 0 or line_size * associativity * a power of two number of sets");
+        } else if (config->drain_interval == 0) {
+            reader.fail("store_buffer", "drain_interval", "must be at least 1");
+        }
+    }
+
+    dram_config_t* dram = &config->dram;
+    dram->channels = reader.get("dram", "channels", false, 0);
+    dram->banks = reader.get("dram", "banks", false, 8);
+    dram->row_size = reader.get("dram", "row_size", false, 8192);
+    dram->t_cas = reader.get("dram", "t_cas", false, 40);
+    dram->t_rcd = reader.get("dram", "t_rcd", false, 40);
+    dram->t_rp = reader.get("dram", "t_rp", false, 40);
+    dram->t_burst = reader.get("dram", "t_burst", false, 8);
+    dram->write_queue = reader.get("dram", "write_queue", false, 32);
+    dram->cache_to_cache = reader.get("dram", "cache_to_cache", false, 40);
+    const std::string* page_policy = reader.find("dram", "page_policy");
+    std::string page_policy_name = page_policy ? lower(*page_policy) : "open";
+    if (page_policy_name == "open") dram->page_policy = OPEN_PAGE;
+    else if (page_policy_name == "closed") dram->page_policy = CLOSED_PAGE;
+    else reader.fail("dram", "page_policy", "expected open or closed, got '" + *page_policy + "'");
+    if (reader.error.empty() && dram->channels > 0) {
+        if (dram->banks == 0) {
+            reader.fail("dram", "banks", "must be at least 1");
+        } else if (!is_power_of_two(dram->row_size) || dram->row_size < line_size) {
+            reader.fail("dram", "row_size", "must be a power of two and at least the line size");
+        } else if (dram->t_burst == 0) {
+            reader.fail("dram", "t_burst", "must be at least 1");
+        } else if (dram->write_queue == 0) {
+            reader.fail("dram", "write_queue", "must be at least 1");
+        }
+    }
+    if (!reader.error.empty()) {
+        *error = reader.error;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef __CONFIG_H
+#define __CONFIG_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "system.h"
+
+/**
+ * Loads a system_config_t from a config file. Two formats are accepted:
+ *
+ * INI, with `key = value` lines under these sections (see config.ini):
+ *   [system]        cores, protocol, memory_size, bus_width, sockets, link_latency, link_bandwidth
+ *   [cache]         line_size, size, associativity, hit_time, miss_penalty, victim_entries,
+ *                   replacement, prefetch
+ *   [core.N]        the [cache] keys
+ *   [llc]           size, associativity, hit_time
+ *   [store_buffer]  entries, drain_interval
+ *   [dram]          channels, banks, row_size, page_policy, t_cas, t_rcd, t_rp, t_burst,
+ *                   write_queue, cache_to_cache
+ * [cache] applies to every core and [core.N] overrides it for core N. Numbers are decimal,
+ * or hex with a 0x prefix. `;` and `#` start comments.
+ *
+ * The original positional format (see config.txt), detected by its first line not
+ * being a section header or key = value pair. It is translated to the same keys, so
+ * overrides and validation work the same for both.
+ *
+ * Overrides are `section.key=value` strings (e.g. `cache.size=65536`, `core.1.associativity=4`)
+ * applied on top of the file. With a NULL path the config is built from the overrides alone.
+ * On error, returns false with a message in error.
+ */
+bool load_config(const char* path, const std::vector<std::string>& overrides, system_config_t* config, std::string* error);
+
+#endif
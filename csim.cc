@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "csim.h"
+#include "config.h"
+#include "system.h"
+#include "trace.h"
+
+struct csim_system {
+    System system;
+    system_config_t config;
+    csim_event_callback_t callback;
+    void* user_data;
+};
+
+// Translate System's events to the C API's
+static void forward_event(const coherence_event_t* event, void* user_data) {
+    csim_system_t* system = (csim_system_t*) user_data;
+    csim_event_t c_event;
+    c_event.type = (int) event->type;
+    c_event.core = event->core;
+    c_event.other = event->other;
+    c_event.address = event->address;
+    system->callback(&c_event, system->user_data);
+}
+
+// section.key=value, as load_config takes it
+static void add_key(std::vector<std::string>* keys, const std::string& name, const std::string& value) {
+    keys->push_back(name + "=" + value);
+}
+
+static void add_cache_keys(std::vector<std::string>* keys, const std::string& section, const csim_cache_config_t& cache) {
+    add_key(keys, section + ".line_size", std::to_string(cache.line_size));
+    add_key(keys, section + ".size", std::to_string(cache.size));
+    add_key(keys, section + ".associativity", std::to_string(cache.associativity));
+    add_key(keys, section + ".hit_time", std::to_string(cache.hit_time));
+    add_key(keys, section + ".miss_penalty", std::to_string(cache.miss_penalty));
+    add_key(keys, section + ".victim_entries", std::to_string(cache.victim_entries));
+}
+
+static void to_csim_cache_config(const Cache::config_t& in, csim_cache_config_t* out) {
+    out->line_size = in.line_size;
+    out->size = in.cache_size;
+    out->associativity = in.associativity;
+    out->hit_time = (unsigned int) in.hit_time;
+    out->miss_penalty = (unsigned int) in.miss_penalty;
+    out->victim_entries = in.victim_entries;
+}
+
+// The inverse of the keys csim_create_from_config passes to load_config. core_caches, if not NULL,
+// gets one entry per core and becomes out->core_caches.
+static void to_csim_config(const system_config_t& in, csim_config_t* out, csim_cache_config_t* core_caches) {
+    out->num_cores = in.num_cores;
+    out->protocol = in.protocol == MESI ? CSIM_MESI : CSIM_MSI;
+    out->memory_size = in.mem_size;
+    out->bus_width = in.bus_width;
+    out->sockets = in.topology.sockets;
+    out->link_latency = in.topology.link_latency;
+    out->link_bandwidth = in.topology.link_bandwidth;
+    to_csim_cache_config(in.caches[0], &out->cache);
+    out->core_caches = core_caches;
+    for (unsigned int i = 0; core_caches && i < in.num_cores; i++) {
+        to_csim_cache_config(in.caches[i], &core_caches[i]);
+    }
+    out->llc.size = in.llc.size;
+    out->llc.associativity = in.llc.associativity;
+    out->llc.hit_time = in.llc.hit_time;
+    out->store_buffer_entries = in.store_buffer_entries;
+    out->drain_interval = in.drain_interval;
+    out->dram.channels = in.dram.channels;
+    out->dram.banks = in.dram.banks;
+    out->dram.row_size = in.dram.row_size;
+    out->dram.page_policy = in.dram.page_policy == CLOSED_PAGE ? CSIM_CLOSED_PAGE : CSIM_OPEN_PAGE;
+    out->dram.t_cas = in.dram.t_cas;
+    out->dram.t_rcd = in.dram.t_rcd;
+    out->dram.t_rp = in.dram.t_rp;
+    out->dram.t_burst = in.dram.t_burst;
+    out->dram.write_queue = in.dram.write_queue;
+    out->dram.cache_to_cache = in.dram.cache_to_cache;
+}
+
+void csim_default_config(csim_config_t* config) {
+    // config.ini's required keys; load_config supplies the defaults of the others
+    static const char* const required[] = {"system.cores=2", "system.memory_size=16777216", "cache.line_size=64",
+        "cache.size=32768", "cache.associativity=8", "cache.hit_time=3", "cache.miss_penalty=200"};
+    std::vector<std::string> keys(required, required + sizeof(required) / sizeof(required[0]));
+    system_config_t loaded;
+    std::string message;
+    load_config(NULL, keys, &loaded, &message);
+    to_csim_config(loaded, config, NULL);
+}
+
+csim_system_t* csim_create_from_config(const csim_config_t* config, char* error, size_t error_size) {
+    // Go through the config file's keys, so a csim_config_t is checked exactly like a file
+    std::vector<std::string> keys;
+    add_key(&keys, "system.cores", std::to_string(config->num_cores));
+    add_key(&keys, "system.protocol", std::to_string(config->protocol));
+    add_key(&keys, "system.memory_size", std::to_string(config->memory_size));
+    add_key(&keys, "system.bus_width", std::to_string(config->bus_width));
+    add_key(&keys, "system.sockets", std::to_string(config->sockets));
+    add_key(&keys, "system.link_latency", std::to_string(config->link_latency));
+    add_key(&keys, "system.link_bandwidth", std::to_string(config->link_bandwidth));
+    add_cache_keys(&keys, "cache", config->cache);
+    for (unsigned int i = 0; config->core_caches && i < config->num_cores; i++) {
+        add_cache_keys(&keys, "core." + std::to_string(i), config->core_caches[i]);
+    }
+    add_key(&keys, "llc.size", std::to_string(config->llc.size));
+    add_key(&keys, "llc.associativity", std::to_string(config->llc.associativity));
+    add_key(&keys, "llc.hit_time", std::to_string(config->llc.hit_time));
+    add_key(&keys, "store_buffer.entries", std::to_string(config->store_buffer_entries));
+    add_key(&keys, "store_buffer.drain_interval", std::to_string(config->drain_interval));
+    add_key(&keys, "dram.channels", std::to_string(config->dram.channels));
+    add_key(&keys, "dram.banks", std::to_string(config->dram.banks));
+    add_key(&keys, "dram.row_size", std::to_string(config->dram.row_size));
+    add_key(&keys, "dram.page_policy", config->dram.page_policy == CSIM_OPEN_PAGE ? "open"
+            : config->dram.page_policy == CSIM_CLOSED_PAGE ? "closed" : std::to_string(config->dram.page_policy));
+    add_key(&keys, "dram.t_cas", std::to_string(config->dram.t_cas));
+    add_key(&keys, "dram.t_rcd", std::to_string(config->dram.t_rcd));
+    add_key(&keys, "dram.t_rp", std::to_string(config->dram.t_rp));
+    add_key(&keys, "dram.t_burst", std::to_string(config->dram.t_burst));
+    add_key(&keys, "dram.write_queue", std::to_string(config->dram.write_queue));
+    add_key(&keys, "dram.cache_to_cache", std::to_string(config->dram.cache_to_cache));
+
+    system_config_t loaded;
+    std::string message;
+    if (!load_config(NULL, keys, &loaded, &message)) {
+        if (error && error_size > 0) snprintf(error, error_size, "%s", message.c_str());
+        return NULL;
+    }
+    csim_system_t* system = new csim_system;
+    system->config = loaded;
+    system->callback = NULL;
+    system->user_data = NULL;
+    system->system.init(system->config);
+    return system;
+}
+
+csim_system_t* csim_create(const char* config_path, const char* const* overrides, unsigned int num_overrides,
+        char* error, size_t error_size) {
+    std::vector<std::string> override_list;
+    for (unsigned int i = 0; i < num_overrides; i++) {
+        override_list.push_back(overrides[i]);
+    }
+    system_config_t loaded;
+    std::string message;
+    if (!load_config(config_path, override_list, &loaded, &message)) {
+        if (error && error_size > 0) snprintf(error, error_size, "%s", message.c_str());
+        return NULL;
+    }
+    std::vector<csim_cache_config_t> core_caches(loaded.num_cores);
+    csim_config_t config;
+    to_csim_config(loaded, &config, &core_caches[0]);
+    return csim_create_from_config(&config, error, error_size);
+}
+
+void csim_destroy(csim_system_t* system) {
+    delete system;
+}
+
+unsigned int csim_num_cores(csim_system_t* system) {
+    return system->config.num_cores;
+}
+
+size_t csim_access_batch(csim_system_t* system, csim_access_t* accesses, size_t count) {
+    unsigned int line_size = system->config.caches[0].line_size;
+    for (size_t i = 0; i < count; i++) {
+        csim_access_t* access = &accesses[i];
+        if (access_error(access->core, access->type, access->address, access->size, system->config.num_cores, line_size)) {
+            return i;
+        }
+        system->system.access(access->core, access->address, (access_t) access->type, access->data, access->size);
+    }
+    return count;
+}
+
+void csim_drain(csim_system_t* system) {
+    system->system.finish();
+}
+
+int csim_get_cache_stats(csim_system_t* system, unsigned int core, csim_cache_stats_t* stats) {
+    if (core >= system->config.num_cores) return -1;
+    stats_t* cache_stats = system->system.get_cache_stats(core);
+    stats->accesses = cache_stats->accesses;
+    stats->hits = cache_stats->hits;
+    stats->misses = cache_stats->misses;
+    stats->victim_hits = cache_stats->victim_hits;
+    stats->writebacks = cache_stats->writebacks;
+    stats->traffic = cache_stats->traffic;
+    stats->miss_cycles = cache_stats->miss_cycles;
+    // get_stats divides by the access count
+    stats->miss_rate = cache_stats->accesses ? cache_stats->miss_rate : 0.0;
+    stats->amat = cache_stats->accesses ? cache_stats->amat : 0.0;
+    return 0;
+}
+
+void csim_get_system_stats(csim_system_t* system, csim_system_stats_t* stats) {
+    const bus_stats_t& bus_stats = system->system.get_bus_stats();
+    stats->read_misses = bus_stats.read_misses;
+    stats->write_misses = bus_stats.write_misses;
+    stats->upgrades = bus_stats.upgrades;
+    stats->invalidations = system->system.get_invalidations();
+    stats->invalidated_copies = bus_stats.invalidated_copies;
+    stats->cache_to_cache = bus_stats.cache_to_cache;
+    stats->mem_fetches = bus_stats.mem_fetches;
+    stats->mem_writebacks = bus_stats.mem_writebacks;
+    stats->evict_writebacks = bus_stats.evict_writebacks;
+    stats->data_bus_transactions = system->system.get_data_bus_transactions();
+}
+
+void csim_print_stats(csim_system_t* system) {
+    system->system.print_stats();
+}
+
+void csim_set_event_callback(csim_system_t* system, csim_event_callback_t callback, void* user_data) {
+    // stop forwarding while the callback changes, in case another thread is simulating
+    system->system.set_event_callback(NULL, NULL);
+    system->callback = callback;
+    system->user_data = user_data;
+    if (callback) system->system.set_event_callback(forward_event, system);
+}
@@ -0,0 +1,183 @@
+#ifndef __CSIM_H
+#define __CSIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * C interface to the simulator, for tools that produce accesses in-process (e.g. a Pin
+ * tool) instead of writing trace files. Build it with `make lib` and link libcsim.a with
+ * a C++ linker. Systems are independent of each other and the library keeps no global
+ * state. One system can be fed from several threads, as long as each core's accesses
+ * come from one thread at a time.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct csim_system csim_system_t;
+
+// Access types, numbered as in trace files
+enum {
+    CSIM_READ = 0,
+    CSIM_WRITE,
+    CSIM_IFETCH,
+    CSIM_SWAP,
+    CSIM_FETCH_ADD,
+    CSIM_CAS,
+    CSIM_FENCE
+};
+
+typedef struct csim_access_t {
+    unsigned int core;
+    int type;
+    unsigned long long address;
+    unsigned int size;      // 1 to 64 bytes and at most a line; atomics at most 8 bytes within one line
+    uint8_t data[64];       // write data or operand (CAS: new value, then compare value), replaced by
+                            // the value read (atomics: the old value)
+} csim_access_t;
+
+// Coherence event types, see csim_event_t
+enum {
+    CSIM_EVENT_READ_MISS = 0,   // core put a read miss on the bus
+    CSIM_EVENT_WRITE_MISS,      // core put a write miss on the bus
+    CSIM_EVENT_UPGRADE,         // core wrote a shared line and invalidated the other copies
+    CSIM_EVENT_CACHE_TO_CACHE,  // other supplied the line to core
+    CSIM_EVENT_MEMORY_FETCH,    // the line core missed on came from memory
+    CSIM_EVENT_INVALIDATION,    // core's request invalidated other's copy
+    CSIM_EVENT_EVICTION,        // core evicted the line to make room for a miss
+    CSIM_EVENT_WRITEBACK,       // the line core evicted was dirty and written back to memory (or its socket's LLC)
+    CSIM_EVENT_LLC_HIT          // the line core missed on came from an LLC: its socket's, or the home socket's
+};
+
+typedef struct csim_event_t {
+    int type;
+    unsigned int core;          // core whose access caused the event
+    unsigned int other;         // the other cache involved, otherwise core
+    unsigned long long address; // line address
+} csim_event_t;
+
+// Called while an access is being simulated; it must not call back into the library
+typedef void (*csim_event_callback_t)(const csim_event_t* event, void* user_data);
+
+typedef struct csim_cache_stats_t {
+    unsigned long long accesses;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long victim_hits;     // misses served by the victim cache
+    unsigned long long writebacks;
+    unsigned long long traffic;         // bytes
+    unsigned long long miss_cycles;     // cycles spent waiting on misses
+    double miss_rate;
+    double amat;                        // cycles
+} csim_cache_stats_t;
+
+typedef struct csim_system_stats_t {
+    unsigned long long read_misses;
+    unsigned long long write_misses;
+    unsigned long long upgrades;
+    unsigned long long invalidations;       // requests that invalidated other caches
+    unsigned long long invalidated_copies;
+    unsigned long long cache_to_cache;
+    unsigned long long mem_fetches;
+    unsigned long long mem_writebacks;
+    unsigned long long evict_writebacks;
+    unsigned long long data_bus_transactions;
+} csim_system_stats_t;
+
+// Coherence protocols and DRAM page policies, see csim_config_t
+enum {
+    CSIM_MSI = 0,
+    CSIM_MESI
+};
+
+enum {
+    CSIM_OPEN_PAGE = 0,
+    CSIM_CLOSED_PAGE
+};
+
+// A core's private cache: the [cache] and [core.N] keys of a config file
+typedef struct csim_cache_config_t {
+    unsigned int line_size;         // bytes, a power of two, the same for every core
+    unsigned int size;              // bytes: line_size * associativity * a power of two number of sets
+    unsigned int associativity;
+    unsigned int hit_time;          // cycles
+    unsigned int miss_penalty;      // cycles
+    unsigned int victim_entries;    // 0 for no victim cache
+} csim_cache_config_t;
+
+// A system, field for field the keys of a config file (see config.ini for their meaning)
+typedef struct csim_config_t {
+    unsigned int num_cores;
+    int protocol;                   // CSIM_MSI or CSIM_MESI
+    unsigned int memory_size;       // bytes
+    unsigned int bus_width;         // bytes
+    unsigned int sockets;
+    unsigned int link_latency;      // cycles per link crossing
+    unsigned int link_bandwidth;    // bytes per cycle
+    csim_cache_config_t cache;      // every core's cache
+    const csim_cache_config_t* core_caches; // NULL, or num_cores caches used instead of cache
+
+    struct {
+        unsigned int size;          // bytes per socket, 0 for no LLC
+        unsigned int associativity;
+        unsigned int hit_time;      // cycles
+    } llc;
+
+    unsigned int store_buffer_entries;      // 0 for no store buffers
+    unsigned int drain_interval;            // accesses between drains of a core's oldest entry
+
+    struct {
+        unsigned int channels;      // per socket, 0 for a fixed miss_penalty per miss
+        unsigned int banks;         // per channel
+        unsigned int row_size;      // bytes
+        int page_policy;            // CSIM_OPEN_PAGE or CSIM_CLOSED_PAGE
+        unsigned int t_cas;         // cycles
+        unsigned int t_rcd;
+        unsigned int t_rp;
+        unsigned int t_burst;
+        unsigned int write_queue;   // posted writebacks per channel
+        unsigned int cache_to_cache; // cycles for a miss supplied by another cache
+    } dram;
+} csim_config_t;
+
+// Fill config with the system of config.ini: 2 MSI cores with 32KB 8-way caches, 16MB of memory,
+// and the file format's defaults for everything optional (no LLC, store buffers or DRAM model)
+void csim_default_config(csim_config_t* config);
+
+// Create a system from config, checked like a config file. On failure returns NULL with a
+// message in error (if not NULL) naming the offending key, e.g. "cache.size: ...".
+csim_system_t* csim_create_from_config(const csim_config_t* config, char* error, size_t error_size);
+
+// Create a system from a config file (either format, see config.h) and section.key=value
+// overrides. On failure returns NULL with a message in error (if not NULL).
+csim_system_t* csim_create(const char* config_path, const char* const* overrides, unsigned int num_overrides,
+        char* error, size_t error_size);
+void csim_destroy(csim_system_t* system);
+
+unsigned int csim_num_cores(csim_system_t* system);
+
+// Simulate count accesses in order. Stops at the first invalid one (bad core, type or size)
+// and returns the number simulated.
+size_t csim_access_batch(csim_system_t* system, csim_access_t* accesses, size_t count);
+
+// Write out stores still held in store buffers and writebacks queued for DRAM, e.g. before
+// reading final stats. Later accesses are timed as if the queues had been drained.
+void csim_drain(csim_system_t* system);
+
+// Stats so far. Query them between batches, not while another thread is simulating.
+// csim_get_cache_stats returns -1 for a core that doesn't exist, otherwise 0.
+int csim_get_cache_stats(csim_system_t* system, unsigned int core, csim_cache_stats_t* stats);
+void csim_get_system_stats(csim_system_t* system, csim_system_stats_t* stats);
+// The simulator's full stats report, on stdout
+void csim_print_stats(csim_system_t* system);
+
+// Report coherence events to callback; NULL stops reporting
+void csim_set_event_callback(csim_system_t* system, csim_event_callback_t callback, void* user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
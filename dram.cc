@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+
+#include "dram.h"
+
+Dram::Dram(const dram_config_t& config) {
+    this->config = config;
+    channels.resize(config.channels);
+    for (unsigned int i = 0; i < config.channels; i++) {
+        bank_t closed = {false, 0, 0};
+        channels[i].banks.assign(config.banks, closed);
+        channels[i].now = 0;
+        channels[i].bus_free = 0;
+        channels[i].bus_busy = 0;
+    }
+    memset(&stats, 0, sizeof(stats));
+}
+
+Dram::channel_t* Dram::locate(addr_t physical_addr, request_t* request) {
+    // row-sized chunks are interleaved across channels, then banks
+    addr_t chunk = physical_addr / config.row_size;
+    request->bank = (unsigned int) ((chunk / config.channels) % config.banks);
+    request->row = (unsigned int) (chunk / ((addr_t) config.channels * config.banks));
+    return &channels[chunk % config.channels];
+}
+
+size_t Dram::pick(channel_t* channel) {
+    std::vector<request_t>& queue = channel->queue;
+    // the scheduler only sees requests that have arrived; if none has, it waits for the first
+    counter_t now = channel->now;
+    counter_t first_arrival = queue[0].arrival;
+    for (size_t i = 1; i < queue.size(); i++) {
+        if (queue[i].arrival < first_arrival) first_arrival = queue[i].arrival;
+    }
+    if (first_arrival > now) now = first_arrival;
+
+    size_t oldest = queue.size();
+    size_t oldest_hit = queue.size();
+    for (size_t i = 0; i < queue.size(); i++) {
+        if (queue[i].arrival > now) continue;
+        bank_t* bank = &channel->banks[queue[i].bank];
+        if (bank->open && bank->row == queue[i].row
+                && (oldest_hit == queue.size() || queue[i].arrival < queue[oldest_hit].arrival)) {
+            oldest_hit = i;
+        }
+        if (oldest == queue.size() || queue[i].arrival < queue[oldest].arrival) oldest = i;
+    }
+    return oldest_hit < queue.size() ? oldest_hit : oldest;
+}
+
+counter_t Dram::issue(channel_t* channel, size_t i) {
+    request_t request = channel->queue[i];
+    channel->queue.erase(channel->queue.begin() + (long) i);
+    bank_t* bank = &channel->banks[request.bank];
+
+    counter_t start = channel->now;
+    if (request.arrival > start) start = request.arrival;
+    if (bank->ready > start) start = bank->ready;
+    counter_t access;
+    if (bank->open && bank->row == request.row) {
+        stats.row_hits++;
+        access = config.t_cas;
+    } else if (!bank->open) {
+        stats.row_misses++;
+        access = config.t_rcd + config.t_cas;
+    } else {
+        stats.row_conflicts++;
+        access = config.t_rp + config.t_rcd + config.t_cas;
+    }
+    counter_t burst = start + access > channel->bus_free ? start + access : channel->bus_free;
+    counter_t done = burst + config.t_burst;
+    channel->bus_free = done;
+    channel->bus_busy += config.t_burst;
+    channel->now = start;
+    if (config.page_policy == OPEN_PAGE) {
+        // further column accesses to the row can start once this one has
+        bank->open = true;
+        bank->row = request.row;
+        bank->ready = start + access;
+    } else {
+        bank->open = false;
+        bank->ready = done + config.t_rp;
+    }
+
+    if (request.write) {
+        stats.writes++;
+    } else {
+        stats.reads++;
+        stats.read_latency += done - request.arrival;
+        stats.read_queueing += start - request.arrival;
+    }
+    return done;
+}
+
+counter_t Dram::read(addr_t physical_addr, counter_t arrival) {
+    request_t request;
+    request.arrival = arrival;
+    request.write = false;
+    channel_t* channel = locate(physical_addr, &request);
+    if (request.arrival < channel->now) request.arrival = channel->now;
+    channel->queue.push_back(request);
+    // reads are waited for, so this is the only read queued; writes the scheduler
+    // prefers go ahead of it
+    while (true) {
+        size_t i = pick(channel);
+        bool write = channel->queue[i].write;
+        counter_t done = issue(channel, i);
+        if (!write) return done - request.arrival;
+    }
+}
+
+void Dram::write(addr_t physical_addr, counter_t arrival) {
+    request_t request;
+    request.arrival = arrival;
+    request.write = true;
+    channel_t* channel = locate(physical_addr, &request);
+    if (request.arrival < channel->now) request.arrival = channel->now;
+    channel->queue.push_back(request);
+    while (channel->queue.size() > config.write_queue) {
+        stats.write_queue_full++;
+        issue(channel, pick(channel));
+    }
+}
+
+void Dram::drain() {
+    for (size_t c = 0; c < channels.size(); c++) {
+        while (!channels[c].queue.empty()) {
+            issue(&channels[c], pick(&channels[c]));
+        }
+    }
+}
+
+void Dram::print_stats() {
+    size_t queued = 0;
+    for (size_t c = 0; c < channels.size(); c++) queued += channels[c].queue.size();
+    counter_t accesses = stats.row_hits + stats.row_misses + stats.row_conflicts;
+    printf("DRAM: %u channel(s), %u bank(s) per channel, %s page\n", config.channels, config.banks,
+            config.page_policy == OPEN_PAGE ? "open" : "closed");
+    printf("  Reads: %llu", stats.reads);
+    if (stats.reads) {
+        printf(" (average latency %.2f cycles, %.2f of them queued)",
+                (double) stats.read_latency / stats.reads, (double) stats.read_queueing / stats.reads);
+    }
+    printf("\n");
+    printf("  Writes: %llu (%llu found the write queue full), %zu still queued\n", stats.writes, stats.write_queue_full, queued);
+    if (accesses) {
+        printf("  Row hits: %llu (%.2f%%), misses: %llu (%.2f%%), conflicts: %llu (%.2f%%)\n",
+                stats.row_hits, 100.0 * stats.row_hits / accesses,
+                stats.row_misses, 100.0 * stats.row_misses / accesses,
+                stats.row_conflicts, 100.0 * stats.row_conflicts / accesses);
+    }
+    for (size_t c = 0; c < channels.size(); c++) {
+        if (channels[c].bus_free == 0) continue;
+        printf("  Channel %zu data bus utilization: %.2f%%\n", c,
+                100.0 * channels[c].bus_busy / channels[c].bus_free);
+    }
+}
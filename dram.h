@@ -0,0 +1,101 @@
+#ifndef __DRAM_H
+#define __DRAM_H
+
+#include <inttypes.h>
+#include <vector>
+
+#include "global_types.h"
+
+typedef enum {
+    OPEN_PAGE = 0,  // rows stay open after an access, so the next access to the row only needs a column access
+    CLOSED_PAGE     // rows are closed (precharged) right after each access
+} page_policy_t;
+
+/**
+ * DRAM organization and timing. Times are in core cycles.
+*/
+typedef struct dram_config_t {
+    unsigned int channels;          // per socket; 0 disables the model and misses cost the caches' miss_penalty
+    unsigned int banks;             // per channel
+    unsigned int row_size;          // bytes held by a bank's row buffer
+    page_policy_t page_policy;
+    unsigned int t_cas;             // column access to an open row
+    unsigned int t_rcd;             // activating a row
+    unsigned int t_rp;              // precharging (closing) a row
+    unsigned int t_burst;           // a line on the channel's data bus
+    unsigned int write_queue;       // posted writes a channel holds before it must issue the oldest
+    unsigned int cache_to_cache;    // cycles for a miss supplied by another cache instead of memory
+} dram_config_t;
+
+/**
+ * DRAM stats, summed over channels
+*/
+typedef struct dram_stats_t {
+    counter_t reads;
+    counter_t writes;
+    counter_t row_hits;         // row already open
+    counter_t row_misses;       // bank had no open row
+    counter_t row_conflicts;    // bank had another row open, which had to be closed first
+    counter_t read_latency;     // sum over reads, from arrival to the end of the data burst
+    counter_t read_queueing;    // sum over reads, from arrival until the read's command was issued
+    counter_t write_queue_full; // writes that found the write queue full and forced the oldest out
+} dram_stats_t;
+
+/**
+ * Memory controller and DRAM behind one memory slice. Lines map to channels and banks
+ * a row at a time, so a stream of lines fills a row buffer before moving on. Each
+ * channel queues requests and issues them FR-FCFS: among the requests that have arrived,
+ * row buffer hits go first, then the oldest. Reads are waited for; writebacks are posted
+ * and wait in the queue, competing with later reads for banks and the data bus.
+ *
+ * Requests arrive at the issuing core's clock. Cores' clocks only roughly agree, so a
+ * request stamped before the channel's last issued command is treated as arriving at
+ * that command: the channel sees requests in trace order, and a core whose clock lags
+ * pays for contention on the channel but not for the lag.
+ */
+class Dram {
+    private:
+        typedef struct request_t {
+            counter_t arrival;
+            unsigned int bank;
+            unsigned int row;
+            bool write;
+        } request_t;
+
+        typedef struct bank_t {
+            bool open;              // a row is in the row buffer
+            unsigned int row;
+            counter_t ready;        // when the bank can start its next access
+        } bank_t;
+
+        typedef struct channel_t {
+            std::vector<request_t> queue;   // requests not issued yet
+            std::vector<bank_t> banks;
+            counter_t now;          // when the last command was issued
+            counter_t bus_free;     // when the data bus is next free
+            counter_t bus_busy;     // cycles the data bus carried data
+        } channel_t;
+
+        dram_config_t config;
+        std::vector<channel_t> channels;
+        dram_stats_t stats;
+
+        channel_t* locate(addr_t physical_addr, request_t* request);
+        // Index of the next request to issue, FR-FCFS
+        size_t pick(channel_t* channel);
+        // Issue and remove a queued request; returns when its data burst ends
+        counter_t issue(channel_t* channel, size_t i);
+
+    public:
+        Dram(const dram_config_t& config);
+        // Latency of a line read arriving at cycle arrival
+        counter_t read(addr_t physical_addr, counter_t arrival);
+        // Post a line write arriving at cycle arrival
+        void write(addr_t physical_addr, counter_t arrival);
+        // Issue every queued write, e.g. at the end of the run
+        void drain();
+        // Stats so far; writes still queued are reported, not issued
+        void print_stats();
+};
+
+#endif
@@ -1,22 +1,39 @@
 #ifndef __GLOBAL_TYPES_H
 #define __GLOBAL_TYPES_H
 
+#include <inttypes.h>
+
 typedef unsigned long long addr_t;		// Data type to hold addresses
 typedef unsigned long long counter_t;	// Data type to hold cache statistic variables
 typedef long long data_t;
 
-extern bool verbose; // global "debug flag" for verbose output 
+#define MAX_ACCESS_SIZE 64  // widest single access in bytes (one 512-bit vector)
 
 // Access types
 typedef enum {
     MEMREAD = 0,
     MEMWRITE,
     IFETCH,
+    ATOMIC_SWAP,        // Atomic read-modify-writes: data holds the operand(s), and returns the old value.
+    ATOMIC_FETCH_ADD,
+    ATOMIC_CAS,         // data holds the new value followed by the compare value
+    FENCE,
     SEND,       // Data copied to bus
     STORE,      // Data copied from bus, stored to mem or cache
     MARKDIRTY
 } access_t;
 
+inline bool is_rmw(access_t access_type) {
+    return access_type == ATOMIC_SWAP || access_type == ATOMIC_FETCH_ADD || access_type == ATOMIC_CAS;
+}
+
+// Processor accesses that modify the line
+inline bool is_write(access_t access_type) {
+    return access_type == MEMWRITE || is_rmw(access_type);
+}
+
+#define MAX_RMW_SIZE 8      // widest atomic read-modify-write in bytes
+
 // Bus messages
 typedef enum {
     NONE = 0, 
@@ -35,6 +52,9 @@ typedef struct bus_t {
     addr_t addr; // address for a DATA request, or for WRITEBACK
     uint8_t* data;
     int source;
+    bool evicted;           // set by a cache when making room for a miss
+    bool evicted_dirty;     // evicted line was dirty; its data is on the bus
+    addr_t evicted_addr;    // address of the evicted line
 } bus_t;
 
 // Cache coherence protocols
@@ -0,0 +1,153 @@
+#ifdef INSTRUMENT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <atomic>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "instrument.h"
+
+static const char* const phase_names[] = {"decode", "cache lookup", "coherence", "memory", "output"};
+
+// Exclusive time and number of timed scopes per phase, added to by every thread
+static std::atomic<unsigned long long> phase_ns[NUM_PHASES];
+static std::atomic<unsigned long long> phase_calls[NUM_PHASES];
+// Innermost running timer on this thread
+static thread_local ScopedTimer* current_timer = NULL;
+
+static unsigned long long loop_start;
+static unsigned long long loop_ns;
+static unsigned int loop_threads;   // threads whose phases are timed, so the loop has loop_ns of each
+static counter_t loop_accesses;
+
+static unsigned long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + (unsigned long long) ts.tv_nsec;
+}
+
+ScopedTimer::ScopedTimer(phase_t phase, bool active) {
+    this->phase = phase;
+    this->active = active;
+    if (!active) return;
+    child_ns = 0;
+    parent = current_timer;
+    current_timer = this;
+    start = now_ns();
+}
+
+ScopedTimer::~ScopedTimer() {
+    if (!active) return;
+    unsigned long long elapsed = now_ns() - start;
+    phase_ns[phase] += elapsed - child_ns;
+    phase_calls[phase]++;
+    if (parent) parent->child_ns += elapsed;
+    current_timer = parent;
+}
+
+// Hardware counters around the main loop, inherited by the -p mode threads
+typedef struct hw_counter_t {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+    int fd;
+    unsigned long long value;
+} hw_counter_t;
+
+#ifdef __linux__
+static hw_counter_t hw_counters[] = {
+    {"Cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1, 0},
+    {"LLC misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, -1, 0},
+    {"Branch misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, -1, 0},
+};
+#define NUM_HW_COUNTERS (sizeof(hw_counters) / sizeof(hw_counters[0]))
+static int hw_errno = 0;   // why a counter could not be opened, 0 if all were
+#endif
+
+void instrument_start(unsigned int threads) {
+    loop_threads = threads;
+#ifdef __linux__
+    for (unsigned int i = 0; i < NUM_HW_COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = hw_counters[i].type;
+        attr.config = hw_counters[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.inherit = 1;
+        hw_counters[i].fd = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (hw_counters[i].fd < 0) {
+            hw_errno = errno;
+            continue;
+        }
+        ioctl(hw_counters[i].fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(hw_counters[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+    loop_start = now_ns();
+}
+
+void instrument_stop(counter_t accesses) {
+    loop_ns = now_ns() - loop_start;
+    loop_accesses = accesses;
+#ifdef __linux__
+    for (unsigned int i = 0; i < NUM_HW_COUNTERS; i++) {
+        if (hw_counters[i].fd < 0) continue;
+        ioctl(hw_counters[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(hw_counters[i].fd, &hw_counters[i].value, sizeof(hw_counters[i].value)) != sizeof(hw_counters[i].value)) {
+            hw_counters[i].value = 0;
+        }
+        close(hw_counters[i].fd);
+    }
+#endif
+}
+
+void instrument_print_summary() {
+    double loop_seconds = loop_ns / 1e9;
+    printf("=================== Simulator Instrumentation =====================\n");
+    printf("Accesses: %llu in %f s (%.0f accesses/sec)\n", loop_accesses, loop_seconds,
+            loop_seconds > 0 ? loop_accesses / loop_seconds : 0.0);
+    // Phase times are summed over the threads, so they are shares of the threads' total time
+    unsigned long long thread_ns = loop_ns * loop_threads;
+    if (loop_threads > 1) {
+        printf("Thread time: %u threads x %f s = %f s; phase times are summed over all threads\n",
+                loop_threads, loop_seconds, thread_ns / 1e9);
+    }
+    printf("%-14s %16s %14s %12s %16s\n", "Phase", "Thread time (s)", "% thread time", "Calls", "Accesses/sec");
+    unsigned long long attributed = 0;
+    for (int i = 0; i < NUM_PHASES; i++) {
+        double seconds = phase_ns[i] / 1e9;
+        attributed += phase_ns[i];
+        printf("%-14s %16f %13.2f%% %12llu %16.0f\n", phase_names[i], seconds,
+                thread_ns ? (100.0 * phase_ns[i]) / thread_ns : 0.0,
+                (unsigned long long) phase_calls[i],
+                seconds > 0 ? loop_accesses / seconds : 0.0);
+    }
+    // time in the loop outside any timer, e.g. locking, dispatch and, in -p mode, waiting
+    unsigned long long other = thread_ns > attributed ? thread_ns - attributed : 0;
+    printf("%-14s %16f %13.2f%%\n", "other", other / 1e9, thread_ns ? (100.0 * other) / thread_ns : 0.0);
+#ifdef __linux__
+    if (hw_errno) {
+        printf("Hardware counters unavailable: perf_event_open: %s\n", strerror(hw_errno));
+    }
+    for (unsigned int i = 0; i < NUM_HW_COUNTERS; i++) {
+        if (hw_counters[i].fd < 0) continue;
+        printf("%s: %llu (%f per access)\n", hw_counters[i].name, hw_counters[i].value,
+                loop_accesses ? (double) hw_counters[i].value / loop_accesses : 0.0);
+    }
+#endif
+    printf("\n");
+}
+
+#endif
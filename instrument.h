@@ -0,0 +1,62 @@
+#ifndef __INSTRUMENT_H
+#define __INSTRUMENT_H
+
+#include "global_types.h"
+
+/**
+ * Optional self-profiling of the simulator, built with `make instrument` (-DINSTRUMENT).
+ * Scoped timers charge the time spent in each phase of an access, exclusive of the
+ * phases nested inside it, and Linux hardware counters are read around the main loop.
+ * Without INSTRUMENT the macros expand to nothing and none of this is compiled.
+ */
+
+// Phases of the simulator's hot path
+typedef enum {
+    PHASE_DECODE = 0,   // reading and parsing trace lines
+    PHASE_CACHE,        // Cache::try_access
+    PHASE_COHERENCE,    // bus transaction in System::access_line after a miss, upgrade or eviction
+    PHASE_MEMORY,       // Memory::access
+    PHASE_OUTPUT,       // printing the access
+    NUM_PHASES
+} phase_t;
+
+#ifdef INSTRUMENT
+
+class ScopedTimer {
+    private:
+        phase_t phase;
+        bool active;
+        unsigned long long start;
+        unsigned long long child_ns;    // time spent in timers nested inside this one
+        ScopedTimer* parent;
+    public:
+        ScopedTimer(phase_t phase, bool active = true);
+        ~ScopedTimer();
+};
+
+// Start and stop the main loop, run by threads threads: wall clock and, where available, hardware counters
+void instrument_start(unsigned int threads);
+void instrument_stop(counter_t accesses);
+void instrument_print_summary();
+
+#define INSTRUMENT_CONCAT_(a, b) a##b
+#define INSTRUMENT_CONCAT(a, b) INSTRUMENT_CONCAT_(a, b)
+// Time the rest of the enclosing scope as phase
+#define INSTRUMENT_SCOPE(phase) ScopedTimer INSTRUMENT_CONCAT(instrument_timer_, __LINE__)(phase)
+// Same, but only if cond holds
+#define INSTRUMENT_SCOPE_IF(phase, cond) ScopedTimer INSTRUMENT_CONCAT(instrument_timer_, __LINE__)(phase, cond)
+#define INSTRUMENT_START(threads) instrument_start(threads)
+#define INSTRUMENT_STOP(accesses) instrument_stop(accesses)
+#define INSTRUMENT_PRINT_SUMMARY() instrument_print_summary()
+
+#else
+
+#define INSTRUMENT_SCOPE(phase)
+#define INSTRUMENT_SCOPE_IF(phase, cond)
+#define INSTRUMENT_START(threads)
+#define INSTRUMENT_STOP(accesses)
+#define INSTRUMENT_PRINT_SUMMARY()
+
+#endif
+
+#endif
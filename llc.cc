@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "llc.h"
+
+LastLevelCache::LastLevelCache(const llc_config_t& config, unsigned int line_size) {
+    this->line_size = line_size;
+    ways = config.associativity;
+    num_sets = config.size / (line_size * ways);
+    storage.assign(config.size, 0);
+    blocks.resize(num_sets * ways);
+    for (unsigned int i = 0; i < num_sets * ways; i++) {
+        blocks[i].line = 0;
+        blocks[i].valid = false;
+        blocks[i].dirty = false;
+        blocks[i].last_use = 0;
+        blocks[i].data = &storage[(size_t) i * line_size];
+    }
+    use_clock = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+LastLevelCache::block_t* LastLevelCache::find(addr_t physical_addr) {
+    addr_t line = physical_addr / line_size;
+    block_t* set = &blocks[(size_t) (line % num_sets) * ways];
+    for (unsigned int way = 0; way < ways; way++) {
+        if (set[way].valid && set[way].line == line) return &set[way];
+    }
+    return NULL;
+}
+
+bool LastLevelCache::read(addr_t physical_addr, uint8_t* data) {
+    block_t* block = find(physical_addr);
+    if (!block) {
+        stats.misses++;
+        return false;
+    }
+    stats.hits++;
+    block->last_use = ++use_clock;
+    memcpy(data, block->data, line_size);
+    return true;
+}
+
+bool LastLevelCache::write(addr_t physical_addr, const uint8_t* data, bool dirty, addr_t* evicted_addr, uint8_t* evicted_data) {
+    bool evicted = false;
+    block_t* block = find(physical_addr);
+    if (!block) {
+        addr_t line = physical_addr / line_size;
+        block_t* set = &blocks[(size_t) (line % num_sets) * ways];
+        // first empty way, otherwise the least recently used
+        block = &set[0];
+        for (unsigned int way = 0; way < ways && block->valid; way++) {
+            if (!set[way].valid || set[way].last_use < block->last_use) block = &set[way];
+        }
+        if (block->valid && block->dirty) {
+            stats.dirty_evictions++;
+            *evicted_addr = block->line * line_size;
+            memcpy(evicted_data, block->data, line_size);
+            evicted = true;
+        }
+        block->line = line;
+        block->valid = true;
+        block->dirty = false;
+    }
+    memcpy(block->data, data, line_size);
+    block->dirty = block->dirty || dirty;
+    block->last_use = ++use_clock;
+    return evicted;
+}
+
+bool LastLevelCache::invalidate(addr_t physical_addr, bool* dirty, uint8_t* dirty_data) {
+    block_t* block = find(physical_addr);
+    *dirty = false;
+    if (!block) return false;
+    stats.invalidations++;
+    if (block->dirty) {
+        *dirty = true;
+        memcpy(dirty_data, block->data, line_size);
+    }
+    block->valid = false;
+    block->dirty = false;
+    return true;
+}
+
+const uint8_t* LastLevelCache::probe(addr_t physical_addr, bool* dirty) {
+    block_t* block = find(physical_addr);
+    *dirty = block && block->dirty;
+    return block ? block->data : NULL;
+}
+
+void LastLevelCache::print_stats() {
+    counter_t lookups = stats.hits + stats.misses;
+    printf("LLC: %zu bytes, %u-way\n"
+            "    Hits: %llu (%f%% of lookups)\n"
+            "    Misses: %llu\n"
+            "    Writebacks from private caches: %llu\n"
+            "    Dirty evictions to memory: %llu\n"
+            "    Copies invalidated by other sockets: %llu\n",
+            storage.size(), ways,
+            stats.hits, lookups ? (100.0 * stats.hits) / lookups : 0.0,
+            stats.misses,
+            stats.writebacks,
+            stats.dirty_evictions,
+            stats.invalidations);
+}
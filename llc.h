@@ -0,0 +1,72 @@
+#ifndef __LLC_H
+#define __LLC_H
+
+#include <inttypes.h>
+#include <vector>
+
+#include "global_types.h"
+
+/**
+ * Shared last-level cache of each socket
+*/
+typedef struct llc_config_t {
+    unsigned int size;              // bytes per socket, 0 for no LLC
+    unsigned int associativity;
+    unsigned int hit_time;          // cycles for a miss served by an LLC
+} llc_config_t;
+
+typedef struct llc_stats_t {
+    counter_t hits;             // lookups for misses in the private caches that found the line
+    counter_t misses;
+    counter_t writebacks;       // lines written back into the LLC by private caches
+    counter_t dirty_evictions;  // dirty lines evicted to memory
+    counter_t invalidations;    // copies dropped because a core in another socket took the line exclusively
+} llc_stats_t;
+
+/**
+ * A socket's LLC, shared by its cores and sitting between their private caches and
+ * memory. Not inclusive: it is filled by misses that go to memory and by writebacks
+ * from the private caches. LRU replacement.
+ *
+ * Only lines of the socket's own memory are held dirty. System writes lines homed in
+ * other sockets through to their home, and drops other sockets' copies when a core
+ * takes a line exclusively, so a clean copy is never stale once no private cache
+ * holds the line dirty.
+ */
+class LastLevelCache {
+    private:
+        typedef struct block_t {
+            addr_t line;            // line number
+            bool valid;
+            bool dirty;
+            counter_t last_use;     // for LRU
+            uint8_t* data;
+        } block_t;
+
+        unsigned int line_size;
+        unsigned int ways;
+        unsigned int num_sets;
+        std::vector<block_t> blocks;    // set after set
+        std::vector<uint8_t> storage;   // the blocks' data
+        counter_t use_clock;
+
+        block_t* find(addr_t physical_addr);
+
+    public:
+        llc_stats_t stats;
+
+        LastLevelCache(const llc_config_t& config, unsigned int line_size);
+        // Copy the line into data if it is held, and count the lookup
+        bool read(addr_t physical_addr, uint8_t* data);
+        // Install or update the line with data, dirty or not (a dirty line stays dirty). Returns true if
+        // this evicted a dirty line, with its address and data in evicted_addr and evicted_data.
+        bool write(addr_t physical_addr, const uint8_t* data, bool dirty, addr_t* evicted_addr, uint8_t* evicted_data);
+        // Drop the line. Returns whether it was held; if it was dirty, dirty is set and its data
+        // copied to dirty_data.
+        bool invalidate(addr_t physical_addr, bool* dirty, uint8_t* dirty_data);
+        // The held line's data (NULL if not held) and dirtiness, without touching LRU or stats
+        const uint8_t* probe(addr_t physical_addr, bool* dirty);
+        void print_stats();
+};
+
+#endif
@@ -5,36 +5,48 @@
 #include <iostream>
 
 #include "memory.h"
+#include "instrument.h"
 
-void Memory::init(unsigned int size, unsigned int block_size, bus_t* bus){
+void Memory::init(unsigned int size, unsigned int block_size){
     mem = new uint8_t[size];
     for (unsigned int i = 0; i < size; i++) mem[i] = 0;
     this->size = size;
     this->block_size = block_size;
-    this->bus = bus;
     writebacks = 0;
     data_reqs = 0;
+    dram = NULL;
+    verbose = false;
 }
 
-void Memory::access(addr_t physical_addr, access_t access_type){
-    uint8_t* mem_block = mem + physical_addr;
+void Memory::enable_dram(const dram_config_t& config) {
+    dram = new Dram(config);
+}
+
+counter_t Memory::access(addr_t physical_addr, access_t access_type, uint8_t* data, counter_t now){
+    INSTRUMENT_SCOPE(PHASE_MEMORY);
+    // transfers are always whole lines
+    uint8_t* mem_block = mem + (physical_addr & ~((addr_t) block_size - 1));
     if (access_type == STORE) {
-        memcpy(mem_block, bus->data, sizeof(uint8_t) * block_size);
+        memcpy(mem_block, data, sizeof(uint8_t) * block_size);
         if (verbose) std::cout << "    WRITEBACK TO MEM\n";
         writebacks++;
-    } else {
-        memcpy(bus->data, mem_block, sizeof(uint8_t) * block_size);
-        if (verbose) std::cout << "    DATA REQ FROM MEM\n";
-        data_reqs++;
+        if (dram) dram->write(physical_addr, now);
+        return 0;
     }
+    memcpy(data, mem_block, sizeof(uint8_t) * block_size);
+    if (verbose) std::cout << "    DATA REQ FROM MEM\n";
+    data_reqs++;
+    return dram ? dram->read(physical_addr, now) : 0;
 }
 
 void Memory::print_stats() {
     printf("Writebacks: %llu\n"
             "Data requests from memory: %llu\n", 
             writebacks, data_reqs);
+    if (dram) dram->print_stats();
 }
 
 Memory::~Memory(){
     delete [] mem;
+    delete dram;
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <inttypes.h>
 #include "cache.h"
+#include "dram.h"
 #include "global_types.h"
 
 class Memory {
@@ -10,12 +11,22 @@ class Memory {
         uint8_t* mem;
         unsigned int size;
         unsigned int block_size;
-        bus_t* bus;
         counter_t writebacks;
         counter_t data_reqs;
+        Dram* dram;     // NULL when transfers aren't timed
+        bool verbose;   // print memory transfers
     public:
-        void init(unsigned int size, unsigned int block_size, bus_t* bus);
-        void access(addr_t physical_addr, access_t access_type);
+        void init(unsigned int size, unsigned int block_size);
+        void set_verbose(bool verbose) { this->verbose = verbose; }
+        // Time transfers with a DRAM model; see dram.h
+        void enable_dram(const dram_config_t& config);
+        // Transfer a line to (SEND) or from (STORE) data at cycle now. Returns the cycles until a SEND's
+        // data arrives, or 0 without a DRAM model; writebacks are posted and return 0.
+        counter_t access(addr_t physical_addr, access_t access_type, uint8_t* data, counter_t now);
+        // Issue the writes still queued in the DRAM model, if any
+        void drain() { if (dram) dram->drain(); }
+        // Contents of the line holding physical_addr, without counting an access
+        const uint8_t* line(addr_t physical_addr) { return mem + (physical_addr & ~((addr_t) block_size - 1)); }
         void print_stats();
         ~Memory();
 };
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+
+#include "profiler.h"
+
+SharingProfiler::SharingProfiler(unsigned int num_cores, unsigned int line_size, unsigned int top_n) {
+    this->num_cores = num_cores;
+    this->line_size = line_size;
+    this->top_n = top_n;
+}
+
+SharingProfiler::line_profile_t* SharingProfiler::get_line(addr_t physical_addr) {
+    addr_t line_addr = physical_addr & ~((addr_t) line_size - 1);
+    std::unordered_map<addr_t, line_profile_t>::iterator it = lines.find(line_addr);
+    if (it != lines.end()) {
+        return &it->second;
+    }
+    // first time this line is seen
+    line_profile_t* line = &lines[line_addr];
+    line->reads.assign(num_cores, 0);
+    line->writes.assign(num_cores, 0);
+    line->touched.assign(num_cores * line_size, 0);
+    line->invalidations = 0;
+    line->false_invalidations = 0;
+    line->transfers = 0;
+    return line;
+}
+
+void SharingProfiler::record_access(unsigned int core, addr_t physical_addr, access_t access_type, unsigned int size, bool new_copy) {
+    line_profile_t* line = get_line(physical_addr);
+    uint8_t* touched = &line->touched[core * line_size];
+    unsigned int offset = (unsigned int) (physical_addr & (line_size - 1));
+    if (new_copy) {
+        for (unsigned int i = 0; i < line_size; i++) touched[i] &= (uint8_t) ~TOUCHED_EPOCH;
+    }
+    uint8_t flags = is_write(access_type) ? TOUCHED_WRITE | TOUCHED_EPOCH : TOUCHED_READ | TOUCHED_EPOCH;
+    if (is_write(access_type)) line->writes[core]++;
+    else line->reads[core]++;
+    for (unsigned int i = offset; i < offset + size; i++) touched[i] |= flags;
+}
+
+void SharingProfiler::record_invalidation(addr_t physical_addr, unsigned int invalidator, unsigned int victim) {
+    line_profile_t* line = get_line(physical_addr);
+    uint8_t* by_invalidator = &line->touched[invalidator * line_size];
+    uint8_t* by_victim = &line->touched[victim * line_size];
+    bool overlap = false;
+    for (unsigned int i = 0; i < line_size; i++) {
+        if (by_invalidator[i] & by_victim[i] & TOUCHED_EPOCH) {
+            overlap = true;
+            break;
+        }
+    }
+    line->invalidations++;
+    if (!overlap) line->false_invalidations++;
+    // victim's copy is gone, so is its epoch
+    for (unsigned int i = 0; i < line_size; i++) by_victim[i] &= (uint8_t) ~TOUCHED_EPOCH;
+}
+
+void SharingProfiler::record_transfer(addr_t physical_addr) {
+    get_line(physical_addr)->transfers++;
+}
+
+sharing_t SharingProfiler::classify(const line_profile_t* line) {
+    unsigned int accessors = 0;
+    unsigned int writers = 0;
+    for (unsigned int core = 0; core < num_cores; core++) {
+        if (line->reads[core] || line->writes[core]) accessors++;
+        if (line->writes[core]) writers++;
+    }
+    if (accessors <= 1) return PRIVATE;
+    if (writers == 0) return READ_SHARED;
+
+    // Falsely shared if every written byte is touched by exactly one core
+    bool overlap = false;
+    for (unsigned int offset = 0; offset < line_size && !overlap; offset++) {
+        unsigned int touching = 0;
+        bool written = false;
+        for (unsigned int core = 0; core < num_cores; core++) {
+            uint8_t flags = line->touched[core * line_size + offset];
+            if (flags) touching++;
+            if (flags & TOUCHED_WRITE) written = true;
+        }
+        if (written && touching > 1) overlap = true;
+    }
+    if (!overlap) return FALSELY_SHARED;
+    if (writers == 1) return PRODUCER_CONSUMER;
+    return MIGRATORY;
+}
+
+void SharingProfiler::print_stats() {
+    counter_t class_lines[NUM_SHARING_CLASSES] = {0};
+    counter_t class_accesses[NUM_SHARING_CLASSES] = {0};
+    counter_t class_invalidations[NUM_SHARING_CLASSES] = {0};
+    counter_t class_transfers[NUM_SHARING_CLASSES] = {0};
+
+    // (coherence events, line address) for ranking contended lines
+    std::vector<std::pair<counter_t, addr_t> > contended;
+
+    for (std::unordered_map<addr_t, line_profile_t>::iterator it = lines.begin(); it != lines.end(); it++) {
+        const line_profile_t* line = &it->second;
+        sharing_t sharing = classify(line);
+        class_lines[sharing]++;
+        for (unsigned int core = 0; core < num_cores; core++) {
+            class_accesses[sharing] += line->reads[core] + line->writes[core];
+        }
+        class_invalidations[sharing] += line->invalidations;
+        class_transfers[sharing] += line->transfers;
+        if (line->invalidations + line->transfers > 0) {
+            contended.push_back(std::make_pair(line->invalidations + line->transfers, it->first));
+        }
+    }
+
+    std::cout << "========================= Sharing Profile =========================\n";
+    printf("Lines touched: %zu\n", lines.size());
+    printf("%-18s %10s %12s %14s %10s\n", "Class", "Lines", "Accesses", "Invalidations", "Transfers");
+    for (int i = 0; i < NUM_SHARING_CLASSES; i++) {
+        printf("%-18s %10llu %12llu %14llu %10llu\n", sharing_names[i],
+                class_lines[i], class_accesses[i], class_invalidations[i], class_transfers[i]);
+    }
+
+    // most coherence events first, ties broken by address so output is stable
+    std::sort(contended.begin(), contended.end(),
+            [](const std::pair<counter_t, addr_t>& a, const std::pair<counter_t, addr_t>& b) {
+                return a.first != b.first ? a.first > b.first : a.second < b.second;
+            });
+    if (contended.size() > top_n) contended.resize(top_n);
+
+    printf("\nTop %zu contended lines (per-core usage: R = read, W = write, B = both, - = none):\n", contended.size());
+    for (unsigned int i = 0; i < contended.size(); i++) {
+        const line_profile_t* line = &lines[contended[i].second];
+        std::string usage;
+        for (unsigned int core = 0; core < num_cores; core++) {
+            if (line->reads[core] && line->writes[core]) usage += 'B';
+            else if (line->writes[core]) usage += 'W';
+            else if (line->reads[core]) usage += 'R';
+            else usage += '-';
+        }
+        printf("  0x%.6llx invalidations: %llu transfers: %llu usage: %s %s\n",
+                contended[i].second, line->invalidations, line->transfers, usage.c_str(), sharing_names[classify(line)]);
+    }
+    print_false_sharing();
+}
+
+void SharingProfiler::print_false_sharing() {
+    counter_t total_invalidations = 0;
+    counter_t total_false = 0;
+    // (false sharing invalidations, line address) for ranking
+    std::vector<std::pair<counter_t, addr_t> > falsely_shared;
+
+    for (std::unordered_map<addr_t, line_profile_t>::iterator it = lines.begin(); it != lines.end(); it++) {
+        total_invalidations += it->second.invalidations;
+        total_false += it->second.false_invalidations;
+        if (it->second.false_invalidations > 0) {
+            falsely_shared.push_back(std::make_pair(it->second.false_invalidations, it->first));
+        }
+    }
+
+    printf("\nInvalidations: %llu (true sharing: %llu, false sharing: %llu, %f%% false)\n",
+            total_invalidations, total_invalidations - total_false, total_false,
+            total_invalidations ? (100.0 * total_false) / total_invalidations : 0.0);
+
+    std::sort(falsely_shared.begin(), falsely_shared.end(),
+            [](const std::pair<counter_t, addr_t>& a, const std::pair<counter_t, addr_t>& b) {
+                return a.first != b.first ? a.first > b.first : a.second < b.second;
+            });
+    if (falsely_shared.size() > top_n) falsely_shared.resize(top_n);
+
+    printf("Top %zu lines by false sharing invalidations:\n", falsely_shared.size());
+    for (unsigned int i = 0; i < falsely_shared.size(); i++) {
+        const line_profile_t* line = &lines[falsely_shared[i].second];
+        printf("  0x%.6llx false: %llu true: %llu\n", falsely_shared[i].second,
+                line->false_invalidations, line->invalidations - line->false_invalidations);
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef __PROFILER_H
+#define __PROFILER_H
+
+#include <inttypes.h>
+#include <iostream>
+#include <vector>
+#include <unordered_map>
+
+#include "global_types.h"
+
+// Sharing pattern of a cache line, decided from all accesses seen during the run
+typedef enum {
+    PRIVATE = 0,        // only one core touched the line
+    READ_SHARED,        // several cores, nobody wrote
+    PRODUCER_CONSUMER,  // one core writes, other cores read
+    MIGRATORY,          // several cores write overlapping bytes
+    FALSELY_SHARED      // several cores, but written bytes are only touched by their writer
+} sharing_t;
+
+#define NUM_SHARING_CLASSES 5
+
+static const char* const sharing_names[] = {"PRIVATE", "READ_SHARED", "PRODUCER_CONSUMER", "MIGRATORY", "FALSELY_SHARED"};
+
+inline std::ostream& operator<<(std::ostream& os, const sharing_t sharing) {
+    return os << sharing_names[sharing];
+}
+
+/**
+ * Per-line profiler fed by System::access. Keeps per-core access counts and
+ * byte usage for every line, plus the coherence events the line caused, and
+ * reports the sharing pattern of each line and the most contended lines.
+ *
+ * Each core also has a byte mask of what it touched since it got its current
+ * copy of the line (its epoch). An invalidation is false sharing when the
+ * epochs of the invalidating core and the invalidated core are disjoint.
+ */
+class SharingProfiler {
+    private:
+        // Flags kept per core per byte of a line
+        static const uint8_t TOUCHED_READ = 1;
+        static const uint8_t TOUCHED_WRITE = 2;
+        static const uint8_t TOUCHED_EPOCH = 4;  // touched since the core got its current copy
+
+        typedef struct line_profile_t {
+            std::vector<counter_t> reads;   // reads per core
+            std::vector<counter_t> writes;  // writes per core
+            std::vector<uint8_t> touched;   // num_cores * line_size flags, indexed core * line_size + offset
+            counter_t invalidations;        // copies of this line invalidated in other caches
+            counter_t false_invalidations;  // invalidations where the two cores touched disjoint bytes
+            counter_t transfers;            // times this line was supplied cache-to-cache
+        } line_profile_t;
+
+        unsigned int num_cores;
+        unsigned int line_size;
+        unsigned int top_n;     // number of contended lines to report
+        std::unordered_map<addr_t, line_profile_t> lines;
+
+        line_profile_t* get_line(addr_t physical_addr);
+        sharing_t classify(const line_profile_t* line);
+        void print_false_sharing();
+
+    public:
+        SharingProfiler(unsigned int num_cores, unsigned int line_size, unsigned int top_n);
+        // new_copy is true when the access brought a fresh copy of the line into the core's cache
+        void record_access(unsigned int core, addr_t physical_addr, access_t access_type, unsigned int size, bool new_copy);
+        void record_invalidation(addr_t physical_addr, unsigned int invalidator, unsigned int victim);
+        void record_transfer(addr_t physical_addr);
+        void print_stats();
+};
+
+#endif
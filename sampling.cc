@@ -0,0 +1,351 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <iostream>
+
+#include "sampling.h"
+#include "trace.h"
+
+#define SIGNATURE_BITS 6                    // signatures have 2^SIGNATURE_BITS buckets
+#define SIGNATURE_SIZE (1 << SIGNATURE_BITS)
+#define REGION_BITS 12                      // accesses are grouped by 4KB region
+#define KMEANS_ITERATIONS 100
+#define KMEANS_RESTARTS 5                   // best of several seeds, by total squared distance
+
+typedef std::vector<double> signature_t;
+
+// Estimated (or measured) totals for one core
+typedef struct core_totals_t {
+    double accesses;
+    double hits;
+    double misses;
+    double victim_hits;
+    double miss_cycles;
+    double writebacks;
+    double traffic;
+} core_totals_t;
+
+// xorshift64, so cluster choices are the same on every platform
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static unsigned int signature_bucket(unsigned int core, addr_t physical_addr, bool write) {
+    uint64_t key = ((((uint64_t) physical_addr >> REGION_BITS) << 8 | core) << 1) | (write ? 1 : 0);
+    return (unsigned int) ((key * 0x9E3779B97F4A7C15ULL) >> (64 - SIGNATURE_BITS));
+}
+
+static double distance(const signature_t& a, const signature_t& b) {
+    double d = 0;
+    for (unsigned int i = 0; i < SIGNATURE_SIZE; i++) d += (a[i] - b[i]) * (a[i] - b[i]);
+    return d;
+}
+
+// k-means with k-means++ seeding. Fills assignment and centroids, returns the total squared distance.
+static double kmeans(const std::vector<signature_t>& signatures, unsigned int k, uint64_t seed,
+        std::vector<unsigned int>* assignment, std::vector<signature_t>* centroids) {
+    unsigned int n = (unsigned int) signatures.size();
+    uint64_t state = seed;
+    centroids->assign(1, signatures[next_random(&state) % n]);
+    std::vector<double> nearest(n);
+    while (centroids->size() < k) {
+        // next centroid is picked with probability proportional to its squared distance from the others
+        double total = 0;
+        for (unsigned int i = 0; i < n; i++) {
+            nearest[i] = distance(signatures[i], centroids->front());
+            for (unsigned int c = 1; c < centroids->size(); c++) {
+                nearest[i] = std::min(nearest[i], distance(signatures[i], (*centroids)[c]));
+            }
+            total += nearest[i];
+        }
+        if (total == 0) break; // fewer distinct signatures than k
+        double pick = (next_random(&state) % 1000000) / 1000000.0 * total;
+        unsigned int chosen = n - 1;
+        for (unsigned int i = 0; i < n; i++) {
+            pick -= nearest[i];
+            if (pick < 0) {
+                chosen = i;
+                break;
+            }
+        }
+        centroids->push_back(signatures[chosen]);
+    }
+
+    assignment->assign(n, 0);
+    double sse = 0;
+    for (unsigned int iteration = 0; iteration < KMEANS_ITERATIONS; iteration++) {
+        bool changed = false;
+        sse = 0;
+        for (unsigned int i = 0; i < n; i++) {
+            unsigned int best = 0;
+            double best_distance = distance(signatures[i], (*centroids)[0]);
+            for (unsigned int c = 1; c < centroids->size(); c++) {
+                double d = distance(signatures[i], (*centroids)[c]);
+                if (d < best_distance) {
+                    best = c;
+                    best_distance = d;
+                }
+            }
+            if ((*assignment)[i] != best || iteration == 0) changed = true;
+            (*assignment)[i] = best;
+            sse += best_distance;
+        }
+        if (!changed) break;
+        // move centroids to the mean of their members; an empty cluster keeps its centroid
+        std::vector<signature_t> sums(centroids->size(), signature_t(SIGNATURE_SIZE, 0));
+        std::vector<unsigned int> members(centroids->size(), 0);
+        for (unsigned int i = 0; i < n; i++) {
+            members[(*assignment)[i]]++;
+            for (unsigned int d = 0; d < SIGNATURE_SIZE; d++) sums[(*assignment)[i]][d] += signatures[i][d];
+        }
+        for (unsigned int c = 0; c < centroids->size(); c++) {
+            if (!members[c]) continue;
+            for (unsigned int d = 0; d < SIGNATURE_SIZE; d++) (*centroids)[c][d] = sums[c][d] / members[c];
+        }
+    }
+    return sse;
+}
+
+std::vector<simpoint_t> select_simpoints(FILE* trace, unsigned int num_cores, unsigned int line_size, counter_t interval_size,
+        unsigned int clusters, unsigned int warmup_intervals) {
+    std::vector<long> offsets;
+    std::vector<counter_t> lengths;
+    std::vector<signature_t> signatures;
+
+    // One pass over the trace, recording where each interval starts and its signature
+    trace_access_t access;
+    signature_t signature(SIGNATURE_SIZE, 0);
+    counter_t count = 0;
+    long start = 0;
+    while (true) {
+        if (count == 0) start = ftell(trace);
+        int decoded = decode_line(trace, &access, num_cores, line_size);
+        if (decoded == 0) break;
+        if (decoded < 0) continue;
+        signature[signature_bucket(access.core, access.address, is_write(access.type))]++;
+        if (++count == interval_size) {
+            offsets.push_back(start);
+            lengths.push_back(count);
+            signatures.push_back(signature);
+            signature.assign(SIGNATURE_SIZE, 0);
+            count = 0;
+        }
+    }
+    if (count > 0) { // partial last interval
+        offsets.push_back(start);
+        lengths.push_back(count);
+        signatures.push_back(signature);
+    }
+    std::vector<simpoint_t> simpoints;
+    if (signatures.empty()) return simpoints;
+    // compare intervals by where their accesses went, not how many there were
+    for (unsigned int i = 0; i < signatures.size(); i++) {
+        for (unsigned int d = 0; d < SIGNATURE_SIZE; d++) signatures[i][d] /= (double) lengths[i];
+    }
+
+    unsigned int k = std::min(clusters, (unsigned int) signatures.size());
+    std::vector<unsigned int> assignment;
+    std::vector<signature_t> centroids;
+    double best_sse = -1;
+    for (unsigned int restart = 0; restart < KMEANS_RESTARTS; restart++) {
+        std::vector<unsigned int> restart_assignment;
+        std::vector<signature_t> restart_centroids;
+        double sse = kmeans(signatures, k, 0x5EED + restart * 0x9E3779B9ULL, &restart_assignment, &restart_centroids);
+        if (best_sse < 0 || sse < best_sse) {
+            best_sse = sse;
+            assignment = restart_assignment;
+            centroids = restart_centroids;
+        }
+    }
+
+    // The member closest to each centroid represents the cluster
+    for (unsigned int c = 0; c < centroids.size(); c++) {
+        simpoint_t simpoint;
+        simpoint.weight = 0;
+        double best_distance = -1;
+        for (unsigned int i = 0; i < signatures.size(); i++) {
+            if (assignment[i] != c) continue;
+            simpoint.weight += lengths[i];
+            double d = distance(signatures[i], centroids[c]);
+            if (best_distance < 0 || d < best_distance) {
+                best_distance = d;
+                simpoint.interval = i;
+            }
+        }
+        if (simpoint.weight == 0) continue;
+        unsigned int first = simpoint.interval - std::min(warmup_intervals, simpoint.interval);
+        simpoint.offset = offsets[first];
+        simpoint.warmup = 0;
+        for (unsigned int i = first; i < simpoint.interval; i++) simpoint.warmup += lengths[i];
+        simpoint.length = lengths[simpoint.interval];
+        simpoints.push_back(simpoint);
+    }
+    // in trace order, so the sampled run reads the file front to back
+    std::sort(simpoints.begin(), simpoints.end(),
+            [](const simpoint_t& a, const simpoint_t& b) { return a.interval < b.interval; });
+    return simpoints;
+}
+
+bool write_simpoints(const char* path, const std::vector<simpoint_t>& simpoints) {
+    FILE* file = fopen(path, "w");
+    if (!file) return false;
+    fprintf(file, "# interval offset warmup length weight\n");
+    for (unsigned int i = 0; i < simpoints.size(); i++) {
+        fprintf(file, "%u %ld %llu %llu %llu\n", simpoints[i].interval, simpoints[i].offset,
+                simpoints[i].warmup, simpoints[i].length, simpoints[i].weight);
+    }
+    fclose(file);
+    return true;
+}
+
+bool read_simpoints(const char* path, std::vector<simpoint_t>* simpoints) {
+    FILE* file = fopen(path, "r");
+    if (!file) return false;
+    char line[256];
+    simpoints->clear();
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == '#') continue;
+        simpoint_t simpoint;
+        if (sscanf(line, "%u %ld %llu %llu %llu", &simpoint.interval, &simpoint.offset,
+                &simpoint.warmup, &simpoint.length, &simpoint.weight) == 5) {
+            simpoints->push_back(simpoint);
+        }
+    }
+    fclose(file);
+    return !simpoints->empty();
+}
+
+static double seconds_since(const struct timespec& start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// Simulate up to count accesses from the trace's current position; returns how many were simulated
+static counter_t simulate_accesses(System* system, FILE* trace, unsigned int num_cores, unsigned int line_size, counter_t count) {
+    trace_access_t access;
+    counter_t done = 0;
+    while (done < count) {
+        int decoded = decode_line(trace, &access, num_cores, line_size);
+        if (decoded == 0) break;
+        if (decoded < 0) continue;
+        system->access(access.core, access.address, access.type, access.data, access.size);
+        done++;
+    }
+    return done;
+}
+
+static void add_stats(core_totals_t* totals, const stats_t* end, const stats_t* start, double scale) {
+    totals->accesses += scale * (double) (end->accesses - start->accesses);
+    totals->hits += scale * (double) (end->hits - start->hits);
+    totals->misses += scale * (double) (end->misses - start->misses);
+    totals->victim_hits += scale * (double) (end->victim_hits - start->victim_hits);
+    totals->miss_cycles += scale * (double) (end->miss_cycles - start->miss_cycles);
+    totals->writebacks += scale * (double) (end->writebacks - start->writebacks);
+    totals->traffic += scale * (double) (end->traffic - start->traffic);
+}
+
+static double relative_error(double estimate, double actual) {
+    if (actual == 0) return estimate == 0 ? 0.0 : 100.0;
+    return 100.0 * fabs(estimate - actual) / actual;
+}
+
+void run_simpoints(FILE* trace, const system_config_t& config, const std::vector<simpoint_t>& simpoints, bool compare_full) {
+    unsigned int num_cores = config.num_cores;
+    unsigned int line_size = config.caches[0].line_size;
+    std::vector<core_totals_t> estimate(num_cores + 1);   // last entry sums all cores
+    memset(&estimate[0], 0, sizeof(core_totals_t) * estimate.size());
+    std::vector<stats_t> start(num_cores);
+    counter_t simulated = 0;
+    counter_t covered = 0;
+
+    struct timespec sampled_start;
+    clock_gettime(CLOCK_MONOTONIC, &sampled_start);
+    for (unsigned int i = 0; i < simpoints.size(); i++) {
+        const simpoint_t* simpoint = &simpoints[i];
+        // each representative runs on a fresh system, warmed up by the accesses just before it
+        System* system = new System();
+        system->init(config);
+        fseek(trace, simpoint->offset, SEEK_SET);
+        simulated += simulate_accesses(system, trace, num_cores, line_size, simpoint->warmup);
+        for (unsigned int core = 0; core < num_cores; core++) start[core] = *system->get_cache_stats(core);
+        counter_t length = simulate_accesses(system, trace, num_cores, line_size, simpoint->length);
+        system->finish();
+        simulated += length;
+        covered += simpoint->weight;
+        double scale = length ? (double) simpoint->weight / length : 0.0;
+        for (unsigned int core = 0; core < num_cores; core++) {
+            add_stats(&estimate[core], system->get_cache_stats(core), &start[core], scale);
+            add_stats(&estimate[num_cores], system->get_cache_stats(core), &start[core], scale);
+        }
+        delete system;
+    }
+    double sampled_seconds = seconds_since(sampled_start);
+
+    std::cout << "========================= SimPoint Sampling ========================\n";
+    printf("Representatives: %zu, covering %llu accesses\n", simpoints.size(), covered);
+    printf("  interval  weight\n");
+    for (unsigned int i = 0; i < simpoints.size(); i++) {
+        printf("  %8u  %6.2f%%\n", simpoints[i].interval, covered ? (100.0 * simpoints[i].weight) / covered : 0.0);
+    }
+    printf("Simulated accesses (including warm-up): %llu (%f%% of the trace)\n", simulated,
+            covered ? (100.0 * simulated) / covered : 0.0);
+    printf("Sampled simulation time: %f s\n", sampled_seconds);
+    printf("\nWeighted estimates:\n");
+    printf("%-6s %14s %12s %14s %14s %16s %12s\n", "Core", "Accesses", "Miss rate", "Misses", "Writebacks", "Traffic (B)", "AMAT");
+    for (unsigned int core = 0; core <= num_cores; core++) {
+        core_totals_t* e = &estimate[core];
+        double miss_rate = e->accesses ? e->misses / e->accesses : 0.0;
+        std::string name = core < num_cores ? std::to_string(core) : "all";
+        printf("%-6s %14.0f %11.4f%% %14.0f %14.0f %16.0f", name.c_str(), e->accesses, 100.0 * miss_rate, e->misses, e->writebacks, e->traffic);
+        if (core < num_cores) {
+            const Cache::config_t* cache = &config.caches[core];
+            double amat = cache->hit_time + (e->accesses ? e->miss_cycles / e->accesses : 0.0);
+            printf(" %12.4f", amat);
+        }
+        printf("\n");
+    }
+
+    if (!compare_full) return;
+
+    struct timespec full_start;
+    clock_gettime(CLOCK_MONOTONIC, &full_start);
+    System* system = new System();
+    system->init(config);
+    fseek(trace, 0, SEEK_SET);
+    simulate_accesses(system, trace, num_cores, line_size, (counter_t) -1);
+    system->finish();
+    double full_seconds = seconds_since(full_start);
+    std::vector<core_totals_t> actual(num_cores + 1);
+    memset(&actual[0], 0, sizeof(core_totals_t) * actual.size());
+    stats_t zero;
+    memset(&zero, 0, sizeof(zero));
+    for (unsigned int core = 0; core < num_cores; core++) {
+        add_stats(&actual[core], system->get_cache_stats(core), &zero, 1.0);
+        add_stats(&actual[num_cores], system->get_cache_stats(core), &zero, 1.0);
+    }
+    delete system;
+
+    printf("\nFull simulation time: %f s (sampling speedup: %.1fx)\n", full_seconds,
+            sampled_seconds > 0 ? full_seconds / sampled_seconds : 0.0);
+    printf("Error against the full run (miss rate in percentage points, the rest relative):\n");
+    printf("%-6s %12s %12s %10s %10s %12s %10s\n", "Core", "Miss rate", "Estimated", "Error", "Misses", "Writebacks", "Traffic");
+    for (unsigned int core = 0; core <= num_cores; core++) {
+        core_totals_t* e = &estimate[core];
+        core_totals_t* a = &actual[core];
+        double estimated_rate = e->accesses ? 100.0 * e->misses / e->accesses : 0.0;
+        double actual_rate = a->accesses ? 100.0 * a->misses / a->accesses : 0.0;
+        std::string name = core < num_cores ? std::to_string(core) : "all";
+        printf("%-6s %11.4f%% %11.4f%% %10.4f %9.2f%% %11.2f%% %9.2f%%\n", name.c_str(), actual_rate, estimated_rate,
+                fabs(estimated_rate - actual_rate),
+                relative_error(e->misses, a->misses),
+                relative_error(e->writebacks, a->writebacks),
+                relative_error(e->traffic, a->traffic));
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef __SAMPLING_H
+#define __SAMPLING_H
+
+#include <stdio.h>
+#include <vector>
+
+#include "system.h"
+
+/**
+ * SimPoint-style sampling. The trace is split into fixed-size intervals, each
+ * summarized by a signature: the fraction of its accesses falling in each bucket
+ * of hashed (core, 4KB region, read/write) tuples. Intervals are clustered with
+ * k-means and the interval nearest each centroid represents its cluster. Only the
+ * representatives are simulated, each on a fresh system preceded by warm-up
+ * accesses, and their cache stats are scaled by the number of accesses their
+ * cluster covers.
+ */
+
+typedef struct simpoint_t {
+    unsigned int interval;  // index of the representative interval
+    long offset;            // trace file offset where simulation starts, including warm-up
+    counter_t warmup;       // accesses simulated before the interval, not counted
+    counter_t length;       // accesses in the interval
+    counter_t weight;       // accesses in the trace the interval stands for (its whole cluster)
+} simpoint_t;
+
+// Pick at most clusters representatives of intervals of interval_size accesses. warmup_intervals
+// intervals before each representative are simulated to warm up the caches.
+std::vector<simpoint_t> select_simpoints(FILE* trace, unsigned int num_cores, unsigned int line_size, counter_t interval_size,
+        unsigned int clusters, unsigned int warmup_intervals);
+
+// Simpoints files have one representative per line: interval, offset, warm-up, length, weight
+bool write_simpoints(const char* path, const std::vector<simpoint_t>& simpoints);
+bool read_simpoints(const char* path, std::vector<simpoint_t>* simpoints);
+
+// Simulate only the representatives and print weighted per-core stats. With compare_full, also
+// simulate the whole trace and report the estimates' error and the speedup.
+void run_simpoints(FILE* trace, const system_config_t& config, const std::vector<simpoint_t>& simpoints, bool compare_full);
+
+#endif
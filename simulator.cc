@@ -6,22 +6,60 @@
 #include <inttypes.h>
 #include <iostream>
 #include <pthread.h>
+#include <sched.h>
+#include <time.h>
 
 #include "global_types.h"
 #include "system.h"
+#include "config.h"
+#include "trace.h"
+#include "sampling.h"
+#include "instrument.h"
+#include "spsc_queue.h"
 
 using namespace std;
 
+// -p mode: a reader thread decodes each trace into a queue that one simulation thread drains
+typedef struct trace_reader_t {
+    FILE* input;
+    SpscQueue<trace_access_t>* queue;
+} trace_reader_t;
+
+#define TRACE_QUEUE_SIZE 4096   // decoded accesses buffered per trace
+#define TRACE_BATCH_SIZE 64     // accesses simulated per queue check
+
+// -p mode: each core's thread collects its output lines and writes them a chunk at a time, so
+// threads don't take a lock per access. A core's lines stay in its trace's order, but lines of
+// different cores are interleaved by chunk.
+#define OUTPUT_BUFFER_SIZE 65536
+#define OUTPUT_LINE_MAX 160     // longest access line, with room to spare
+
+typedef struct output_buffer_t {
+    char data[OUTPUT_BUFFER_SIZE];
+    size_t used;
+    counter_t accesses;     // accesses this thread simulated
+} output_buffer_t;
+
 System sys;
+system_config_t config;
 pthread_t* cpu_threads;
-pthread_mutex_t simulator_mutex;
-bool verbose;
+pthread_mutex_t simulator_mutex;   // guards trace_accesses in -p mode
 bool test;
+bool verbose;
+unsigned int line_size;
+counter_t trace_accesses;
+static thread_local output_buffer_t* output = NULL; // this -p thread's buffer; NULL prints directly
 
 FILE* open_file(const char *filename);
+void simulate(trace_access_t* access);
+void begin_output(output_buffer_t* buffer);
+void flush_output();
+void end_output();
 int next_line(FILE* trace);
-unsigned int init(FILE* config);
+unsigned int init(const char* config_path, const vector<string>& overrides);
 void* cpu_thread_sim(void* trace);
+void* trace_reader_thread(void* reader);
+void* cpu_thread_consume(void* reader);
 void print_usage_and_exit(void);
 map<char, vector<string> > parse_args(int argc, char** argv);
 
@@ -34,71 +72,168 @@ FILE* open_file(const char *filename) {
     return file;
 }
 
-int next_line(FILE* trace) {
-    if (feof(trace) || ferror(trace)) {
-        return 0;
+void simulate(trace_access_t* access) {
+    unsigned int core = access->core;
+    addr_t address = access->address;
+    access_t t = access->type;
+    unsigned int size = access->size;
+    uint8_t* data = access->data;
+    uint8_t* expected = access->expected;
+
+    sys.access(core, address, t, data, size);
+    INSTRUMENT_SCOPE(PHASE_OUTPUT);
+    // print at most the first 8 bytes
+    unsigned int shown = size < 8 ? size : 8;
+    unsigned long long accessed_data = 0;
+    unsigned long long expected_data = 0;
+    for (unsigned int i = 0; i < shown; i++) {
+        accessed_data |= (unsigned long long) data[i] << (8 * i);
+        expected_data |= (unsigned long long) expected[i] << (8 * i);
     }
-    else {
-        unsigned int core;
-        access_t t;
-        addr_t address;
-        uint8_t data = 0;
-        char line[30];
-        fgets(line , 30, trace);
-        if (test) {
-            sscanf(line, "%u %d %llx %" SCNx8 "\n", &core, &t, &address, &data);
-        } else {
-            sscanf(line, "%u %d %llx ", &core, &t, &address);
-            if (t == MEMWRITE) sscanf(line, "%*u %*d %*llx %" SCNx8 "\n",  &data);
-        }
-        pthread_mutex_lock(&simulator_mutex);
-        uint8_t accessed_data = sys.access(core, address, t, data);
-        if (t == MEMWRITE) {
-            printf("core%u w 0x%.6llx <= 0x%.2hhx", core, address, accessed_data);
-        } else {
-            printf("core%u r 0x%.6llx => 0x%.2hhx", core, address, accessed_data);
-        }
-        if (test) {
-            printf(" expected: 0x%.2hhx", data);
-            if (accessed_data != data) {
-                printf(" ERROR: MISMATCH");
-            }
+    char line[OUTPUT_LINE_MAX];
+    size_t n;
+    if (t == FENCE) {
+        n = (size_t) snprintf(line, sizeof(line), "core%u fence", core);
+    } else if (is_rmw(t)) {
+        // atomics print the old value
+        const char* names[] = {"swap", "fadd", "cas"};
+        n = (size_t) snprintf(line, sizeof(line), "core%u %s 0x%.6llx => 0x%.*llx", core, names[t - ATOMIC_SWAP], address, 2 * shown, accessed_data);
+    } else if (t == MEMWRITE) {
+        n = (size_t) snprintf(line, sizeof(line), "core%u w 0x%.6llx <= 0x%.*llx", core, address, 2 * shown, accessed_data);
+    } else {
+        n = (size_t) snprintf(line, sizeof(line), "core%u r 0x%.6llx => 0x%.*llx", core, address, 2 * shown, accessed_data);
+    }
+    if (size > 8) {
+        n += (size_t) snprintf(line + n, sizeof(line) - n, " (%u bytes)", size);
+    }
+    if (test && (t == MEMREAD || t == MEMWRITE || t == IFETCH)) {
+        n += (size_t) snprintf(line + n, sizeof(line) - n, " expected: 0x%.*llx", 2 * shown, expected_data);
+        if (memcmp(data, expected, size) != 0) {
+            n += (size_t) snprintf(line + n, sizeof(line) - n, " ERROR: MISMATCH");
         }
-        printf("\n");
-        pthread_mutex_unlock(&simulator_mutex);
     }
-    return 1;
+    line[n++] = '\n';
+
+    if (!output) {
+        trace_accesses++;
+        fwrite(line, 1, n, stdout);
+        return;
+    }
+    output->accesses++;
+    if (output->used + n > OUTPUT_BUFFER_SIZE) flush_output();
+    memcpy(output->data + output->used, line, n);
+    output->used += n;
+    // keep verbose messages, which System prints directly, near their access
+    if (verbose) flush_output();
+}
+
+void begin_output(output_buffer_t* buffer) {
+    buffer->used = 0;
+    buffer->accesses = 0;
+    output = buffer;
+}
+
+void flush_output() {
+    // one write per chunk; stdio locks stdout, so chunks of different threads don't mix
+    fwrite(output->data, 1, output->used, stdout);
+    output->used = 0;
+}
+
+void end_output() {
+    flush_output();
+    pthread_mutex_lock(&simulator_mutex);
+    trace_accesses += output->accesses;
+    pthread_mutex_unlock(&simulator_mutex);
+    output = NULL;
 }
 
-unsigned int init(FILE* config) {
-    unsigned int num_cpus;
-    protocol_t protocol;
-    Cache::config_t cache_cfg1;
-    cache_cfg1.cache_type = L1;
-    unsigned int mem_size;
-    unsigned int bus_width;
-    fscanf(config, "%u, %d\n", &num_cpus, &protocol);
-    fscanf(config, "%u, %u, %u, %d, %d\n", &cache_cfg1.line_size, 
-            &cache_cfg1.cache_size, &cache_cfg1.associativity, &cache_cfg1.hit_time, &cache_cfg1.miss_penalty);
-    fscanf(config, "%u, %u", &mem_size, &bus_width);
-    sys.init(num_cpus, protocol, cache_cfg1, mem_size, bus_width);
-    return num_cpus;
+int next_line(FILE* trace) {
+    trace_access_t access;
+    int decoded = decode_line(trace, &access, config.num_cores, line_size);
+    if (decoded == 1) simulate(&access);
+    return decoded != 0;
+}
+
+unsigned int init(const char* config_path, const vector<string>& overrides) {
+    string error;
+    if (!load_config(config_path, overrides, &config, &error)) {
+        cerr << "Invalid config: " << error << "\n";
+        exit(-1);
+    }
+    line_size = config.caches[0].line_size;
+    sys.init(config);
+    return config.num_cores;
 }
 
 void* cpu_thread_sim(void* trace) {
     FILE* input = (FILE*) trace;
+    output_buffer_t* buffer = new output_buffer_t;
+    begin_output(buffer);
     while (next_line(input));
+    end_output();
+    delete buffer;
     fclose(input);
     pthread_exit(NULL);
 }
 
+void* trace_reader_thread(void* reader) {
+    trace_reader_t* r = (trace_reader_t*) reader;
+    while (true) {
+        trace_access_t* slot = r->queue->reserve();
+        if (!slot) {
+            sched_yield(); // simulation is behind, let it catch up
+            continue;
+        }
+        int decoded = decode_line(r->input, slot, config.num_cores, line_size);
+        if (decoded == 0) break;
+        if (decoded == 1) r->queue->push();
+    }
+    r->queue->close();
+    fclose(r->input);
+    pthread_exit(NULL);
+}
+
+void* cpu_thread_consume(void* reader) {
+    SpscQueue<trace_access_t>* queue = ((trace_reader_t*) reader)->queue;
+    output_buffer_t* buffer = new output_buffer_t;
+    begin_output(buffer);
+    while (true) {
+        size_t batch = queue->peek(TRACE_BATCH_SIZE);
+        if (batch == 0) {
+            if (queue->drained()) break;
+            sched_yield(); // reader is behind
+            continue;
+        }
+        for (size_t i = 0; i < batch; i++) {
+            simulate(queue->front(i));
+        }
+        queue->pop(batch);
+    }
+    end_output();
+    delete buffer;
+    pthread_exit(NULL);
+}
+
 void print_usage_and_exit() {
     cout << "\nUsage:\n  ./simulator <config file> {-s <trace file> | -p <trace file>...} [options]\n\n"
             "   -s : Single trace file for all cores, single thread for sequential accesses to cores.\n"
-            "   -p : One trace file for each core, cores access in parallel. Must have one trace file listed per core in config.\n\n"
+            "   -p : One trace file for each core, cores access in parallel. Must have one trace file listed per core in config.\n"
+            "        Each trace is read and decoded by its own thread, ahead of the core simulating it.\n\n"
             "  options:\n"
             "   -v : Verbose output; see when there is a data request from memory, writeback to memory, invalidation, and state changes for cache blocks.\n"
-            "   -t : Test mode; requires read trace lines to have expected data. The simulator will compare actual returned data with expected data.\n\n";
+            "   -t : Test mode; requires read trace lines to have expected data. The simulator will compare actual returned data with expected data.\n"
+            "   -c : Coherence check; after every access, check the single-writer/multiple-readers invariant and that caches, memory and\n"
+            "        returned data agree with a golden flat memory. Violations are printed and make the simulator exit with status 1.\n"
+            "   -f : Snoop filter; send misses and invalidations only to caches that hold the line, instead of broadcasting them.\n"
+            "   -l [N] : Line profile; classify the sharing pattern of every line and report the N most contended lines (default 10).\n"
+            "   -o <section.key=value>... : Override config file values, e.g. -o cache.size=65536 core.1.associativity=4.\n"
+            "   -k [interval] [clusters] [warm-up] : With -s, SimPoint-style sampling. Split the trace into intervals of this many accesses\n"
+            "        (default 100000), cluster them into at most this many groups (default 10), write the representative intervals\n"
+            "        to <trace file>.simpoints, and simulate only those, each after this many intervals of warm-up (default 1).\n"
+            "        Prints weighted stats instead of per-access output.\n"
+            "   -K <simpoints file> : With -s, sample using representative intervals written by an earlier -k run.\n"
+            "   -e : With -k or -K, also simulate the whole trace and report the sampling error and speedup.\n"
+            "   -r : With -p, each core's thread decodes its own trace between accesses instead of using a reader thread.\n\n";
 
     exit(-1);
 }
@@ -118,13 +253,12 @@ map<char, vector<string> > parse_args(int argc, char** argv) {
                     j++;
                 }
             } else {
-                const char key = argv[i][1];
-                vector<string> values;
+                // repeated options (e.g. -o) accumulate their values
+                vector<string>& values = args[argv[i][1]];
                 while (i + 1 < argc && argv[i + 1][0] != '-') {
                     values.push_back(string(argv[i + 1]));
                     i++;
                 }
-                args[key] = values;
             }
         }
     }
@@ -132,52 +266,122 @@ map<char, vector<string> > parse_args(int argc, char** argv) {
 }
 
 int main(int argc, char** argv) {
-    FILE *config;
-
     map<char, vector<string> > args = parse_args(argc, argv);
     
-    config = open_file(argv[1]);
-    unsigned int num_cpus = init(config);
+    unsigned int num_cpus = init(argv[1], args['o']);
     pthread_mutex_init(&simulator_mutex, NULL);
 
     verbose = args.count('v');
+    sys.set_verbose(verbose);
     test = args.count('t');
+    if (args.count('f') && !sys.enable_snoop_filter()) {
+        cout << "The snoop filter supports at most 64 cores.\n";
+        exit(-1);
+    }
+    if (args.count('c')) {
+        sys.enable_checker();
+    }
+    if (args.count('l')) {
+        sys.enable_profiler(args['l'].empty() ? 10 : (unsigned int) atoi(args['l'][0].c_str()));
+    }
 
     if (args.count('p')) {
         if (args['p'].size() < num_cpus) {
             cout << "Not enough trace files provided for parallel access.\n";
             print_usage_and_exit();
         }
+        sys.enable_fast_path();
         cpu_threads = new pthread_t[num_cpus];
-    
+        pthread_t* reader_threads = NULL;
+        trace_reader_t* readers = NULL;
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        INSTRUMENT_START(args.count('r') ? num_cpus : 2 * num_cpus);
 
-        // create thread for each cpu
-        for (unsigned int i = 0; i < num_cpus; i++) {
-            pthread_create(&cpu_threads[i], NULL, cpu_thread_sim, (void*) open_file(&args['p'][i][0]));
+        if (args.count('r')) {
+            // create thread for each cpu
+            for (unsigned int i = 0; i < num_cpus; i++) {
+                pthread_create(&cpu_threads[i], NULL, cpu_thread_sim, (void*) open_file(&args['p'][i][0]));
+            }
+        } else {
+            // a reader and a simulation thread for each cpu, connected by a queue
+            reader_threads = new pthread_t[num_cpus];
+            readers = new trace_reader_t[num_cpus];
+            for (unsigned int i = 0; i < num_cpus; i++) {
+                readers[i].input = open_file(&args['p'][i][0]);
+                readers[i].queue = new SpscQueue<trace_access_t>(TRACE_QUEUE_SIZE);
+                pthread_create(&reader_threads[i], NULL, trace_reader_thread, (void*) &readers[i]);
+                pthread_create(&cpu_threads[i], NULL, cpu_thread_consume, (void*) &readers[i]);
+            }
         }
 
         // wait for all threads to finish
         for (unsigned int i = 0; i < num_cpus; i++) {
             pthread_join(cpu_threads[i], NULL);
+            if (reader_threads) pthread_join(reader_threads[i], NULL);
         }
+        INSTRUMENT_STOP(trace_accesses);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double seconds = (double) (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
 
+        sys.finish();
         sys.print_stats();
+        printf("Parallel simulation (%s): %llu accesses in %f s (%.0f accesses/sec)\n",
+                reader_threads ? "reader threads" : "-r, decode in core threads",
+                trace_accesses, seconds, seconds > 0 ? trace_accesses / seconds : 0.0);
+        INSTRUMENT_PRINT_SUMMARY();
 
-        fclose(config);
-        delete cpu_threads;
+        if (readers) {
+            for (unsigned int i = 0; i < num_cpus; i++) delete readers[i].queue;
+            delete [] readers;
+            delete [] reader_threads;
+        }
+        delete [] cpu_threads;
         pthread_mutex_destroy(&simulator_mutex);
+    } else if (args.count('s') && (args.count('k') || args.count('K'))) {
+        FILE* input = open_file(&args['s'][0][0]);
+        vector<simpoint_t> simpoints;
+        if (args.count('K')) {
+            if (args['K'].empty() || !read_simpoints(args['K'][0].c_str(), &simpoints)) {
+                cerr << "Could not read representative intervals from " << (args['K'].empty() ? "(none given)" : args['K'][0]) << "\n";
+                exit(-1);
+            }
+        } else {
+            vector<string>& k = args['k'];
+            counter_t interval_size = k.size() > 0 ? strtoull(k[0].c_str(), NULL, 10) : 100000;
+            unsigned int clusters = k.size() > 1 ? (unsigned int) atoi(k[1].c_str()) : 10;
+            unsigned int warmup_intervals = k.size() > 2 ? (unsigned int) atoi(k[2].c_str()) : 1;
+            if (interval_size == 0 || clusters == 0) {
+                cerr << "Interval size and number of clusters must be at least 1\n";
+                exit(-1);
+            }
+            struct timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            simpoints = select_simpoints(input, config.num_cores, line_size, interval_size, clusters, warmup_intervals);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            printf("Interval analysis time: %f s\n", (double) (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+            string path = args['s'][0] + ".simpoints";
+            if (write_simpoints(path.c_str(), simpoints)) {
+                cout << "Representative intervals written to " << path << "\n";
+            }
+        }
+        run_simpoints(input, config, simpoints, args.count('e'));
+        fclose(input);
     } else if (args.count('s')) {
         FILE* input = open_file(&args['s'][0][0]);
+        INSTRUMENT_START(1);
         while (next_line(input));
+        INSTRUMENT_STOP(trace_accesses);
+        sys.finish();
         sys.print_stats();
+        INSTRUMENT_PRINT_SUMMARY();
         fclose(input);
-        fclose(config);
     } else {
         print_usage_and_exit();
     }
 
     cout << "Simulation Completed\n";
 
-    return 0;
+    return sys.coherence_violations() ? 1 : 0;
 }
 
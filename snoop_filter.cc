@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+
+#include "snoop_filter.h"
+
+SnoopFilter::SnoopFilter(unsigned int line_size) {
+    this->line_size = line_size;
+    lookups = 0;
+    empty_lookups = 0;
+    probes = 0;
+    probes_saved = 0;
+}
+
+uint64_t SnoopFilter::lookup(unsigned int requester, addr_t physical_addr, unsigned int num_caches) {
+    lookups++;
+    uint64_t others = 0;
+    std::unordered_map<addr_t, uint64_t>::iterator it = sharers.find(line_addr(physical_addr));
+    if (it != sharers.end()) {
+        others = it->second & ~((uint64_t) 1 << requester);
+    }
+    counter_t probed = (counter_t) __builtin_popcountll(others);
+    if (probed == 0) empty_lookups++;
+    probes += probed;
+    probes_saved += (num_caches - 1) - probed;
+    return others;
+}
+
+void SnoopFilter::add(unsigned int cache, addr_t physical_addr) {
+    sharers[line_addr(physical_addr)] |= (uint64_t) 1 << cache;
+}
+
+void SnoopFilter::remove(unsigned int cache, addr_t physical_addr) {
+    std::unordered_map<addr_t, uint64_t>::iterator it = sharers.find(line_addr(physical_addr));
+    if (it == sharers.end()) return;
+    it->second &= ~((uint64_t) 1 << cache);
+    if (it->second == 0) sharers.erase(it);
+}
+
+uint64_t SnoopFilter::holders(addr_t physical_addr) {
+    std::unordered_map<addr_t, uint64_t>::iterator it = sharers.find(line_addr(physical_addr));
+    return it == sharers.end() ? 0 : it->second;
+}
+
+void SnoopFilter::print_stats() {
+    printf("Snoop filter:\n"
+            "    Lookups: %llu\n"
+            "    No other sharers (all probes skipped): %llu (%f%%)\n"
+            "    Caches probed: %llu\n"
+            "    Probes saved: %llu\n",
+            lookups,
+            empty_lookups, lookups ? (100.0 * empty_lookups) / lookups : 0.0,
+            probes,
+            probes_saved);
+}
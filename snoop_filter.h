@@ -0,0 +1,37 @@
+#ifndef __SNOOP_FILTER_H
+#define __SNOOP_FILTER_H
+
+#include <inttypes.h>
+#include <unordered_map>
+
+#include "global_types.h"
+
+/**
+ * Exact snoop filter: an inclusive directory of which caches hold each line,
+ * kept up to date by System on every fill, eviction, and invalidation.
+ * Caches missing from a line's sharer mask are known not to hold it and are
+ * not probed. Supports up to 64 caches.
+ */
+class SnoopFilter {
+    private:
+        unsigned int line_size;
+        std::unordered_map<addr_t, uint64_t> sharers; // line address -> bit per cache holding it
+        counter_t lookups;
+        counter_t empty_lookups;    // no other cache held the line, every probe skipped
+        counter_t probes;           // caches probed
+        counter_t probes_saved;     // caches a broadcast would have probed but the filter skipped
+
+        addr_t line_addr(addr_t physical_addr) { return physical_addr & ~((addr_t) line_size - 1); }
+
+    public:
+        SnoopFilter(unsigned int line_size);
+        // Caches other than requester that may hold the line, and record the probes this saves
+        uint64_t lookup(unsigned int requester, addr_t physical_addr, unsigned int num_caches);
+        void add(unsigned int cache, addr_t physical_addr);
+        void remove(unsigned int cache, addr_t physical_addr);
+        // Bit per cache the filter thinks holds the line, without counting a lookup
+        uint64_t holders(addr_t physical_addr);
+        void print_stats();
+};
+
+#endif
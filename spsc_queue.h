@@ -0,0 +1,79 @@
+#ifndef __SPSC_QUEUE_H
+#define __SPSC_QUEUE_H
+
+#include <stddef.h>
+#include <atomic>
+
+/**
+ * Bounded lock-free ring buffer for exactly one producer thread and one consumer
+ * thread. Capacity is rounded up to a power of two. The producer publishes items
+ * by advancing tail with a release store and the consumer frees slots by advancing
+ * head, so neither side ever takes a lock. Both indices only grow; they are masked
+ * into the ring on use.
+ */
+template <class T>
+class SpscQueue {
+    private:
+        static const size_t CACHE_LINE = 64;
+
+        T* ring;
+        size_t mask;
+        // Producer and consumer indices on their own lines so the two threads don't false share
+        alignas(CACHE_LINE) std::atomic<size_t> head;   // next slot to pop, written by the consumer
+        alignas(CACHE_LINE) std::atomic<size_t> tail;   // next slot to push, written by the producer
+        alignas(CACHE_LINE) std::atomic<bool> closed;   // producer is done, nothing more will be pushed
+
+    public:
+        SpscQueue(size_t capacity) {
+            size_t size = 1;
+            while (size < capacity) size <<= 1;
+            ring = new T[size];
+            mask = size - 1;
+            head.store(0, std::memory_order_relaxed);
+            tail.store(0, std::memory_order_relaxed);
+            closed.store(false, std::memory_order_relaxed);
+        }
+
+        ~SpscQueue() {
+            delete [] ring;
+        }
+
+        // Producer: slot for the next item, or NULL if the ring is full. The item is
+        // published by push(), so it can be filled in place without a copy.
+        T* reserve() {
+            size_t t = tail.load(std::memory_order_relaxed);
+            if (t - head.load(std::memory_order_acquire) > mask) return NULL;
+            return &ring[t & mask];
+        }
+
+        void push() {
+            tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        void close() {
+            closed.store(true, std::memory_order_release);
+        }
+
+        // Consumer: number of items ready, up to max, starting at front(). 0 means the queue is
+        // empty for now; drained() tells whether more can come.
+        size_t peek(size_t max) {
+            size_t available = tail.load(std::memory_order_acquire) - head.load(std::memory_order_relaxed);
+            return available < max ? available : max;
+        }
+
+        T* front(size_t i) {
+            return &ring[(head.load(std::memory_order_relaxed) + i) & mask];
+        }
+
+        // Release n items returned by peek() back to the producer
+        void pop(size_t n) {
+            head.store(head.load(std::memory_order_relaxed) + n, std::memory_order_release);
+        }
+
+        bool drained() {
+            // check closed first: once it is set, every push is already visible
+            return closed.load(std::memory_order_acquire) && peek(1) == 0;
+        }
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "store_buffer.h"
+
+void StoreBuffer::init(unsigned int depth, unsigned int line_size, unsigned int drain_interval) {
+    this->depth = depth;
+    this->line_size = line_size;
+    this->drain_interval = drain_interval;
+    ticks = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool StoreBuffer::tick() {
+    if (++ticks < drain_interval) return false;
+    ticks = 0;
+    return !entries.empty();
+}
+
+bool StoreBuffer::store(addr_t physical_addr, const uint8_t* data, unsigned int size) {
+    unsigned int offset = (unsigned int) (physical_addr & (line_size - 1));
+    if (!entries.empty() && entries.back().line_addr == line_addr(physical_addr)) {
+        entry_t* youngest = &entries.back();
+        stats.stores++;
+        stats.coalesced++;
+        // unbuffered, this store would have had to get the line back from the other core
+        if (youngest->contended) stats.bus_saved++;
+        youngest->contended = false;
+        memcpy(&youngest->data[offset], data, size);
+        memset(&youngest->written[offset], 1, size);
+        return true;
+    }
+    if (full()) return false;
+    stats.stores++;
+    entries.push_back(entry_t());
+    entry_t* entry = &entries.back();
+    entry->line_addr = line_addr(physical_addr);
+    entry->data.assign(line_size, 0);
+    entry->written.assign(line_size, 0);
+    entry->contended = false;
+    memcpy(&entry->data[offset], data, size);
+    memset(&entry->written[offset], 1, size);
+    return true;
+}
+
+StoreBuffer::forward_t StoreBuffer::forward(addr_t physical_addr, uint8_t* data, unsigned int size) {
+    unsigned int offset = (unsigned int) (physical_addr & (line_size - 1));
+    addr_t line = line_addr(physical_addr);
+    unsigned int found = 0;
+    for (unsigned int i = 0; i < size; i++) {
+        // youngest store to the byte wins
+        for (std::deque<entry_t>::reverse_iterator it = entries.rbegin(); it != entries.rend(); it++) {
+            if (it->line_addr == line && it->written[offset + i]) {
+                data[i] = it->data[offset + i];
+                found++;
+                break;
+            }
+        }
+    }
+    if (found == 0) return FORWARD_NONE;
+    if (found < size) return FORWARD_PARTIAL;
+    return FORWARD_ALL;
+}
+
+unsigned int StoreBuffer::drains_needed(addr_t physical_addr, unsigned int size) {
+    unsigned int offset = (unsigned int) (physical_addr & (line_size - 1));
+    addr_t line = line_addr(physical_addr);
+    unsigned int needed = 0;
+    for (unsigned int e = 0; e < entries.size(); e++) {
+        if (entries[e].line_addr != line) continue;
+        for (unsigned int i = offset; i < offset + size; i++) {
+            if (entries[e].written[i]) {
+                needed = e + 1;
+                break;
+            }
+        }
+    }
+    return needed;
+}
+
+void StoreBuffer::note_remote_access(addr_t physical_addr) {
+    addr_t line = line_addr(physical_addr);
+    for (std::deque<entry_t>::iterator it = entries.begin(); it != entries.end(); it++) {
+        if (it->line_addr == line) it->contended = true;
+    }
+}
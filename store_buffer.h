@@ -0,0 +1,76 @@
+#ifndef __STORE_BUFFER_H
+#define __STORE_BUFFER_H
+
+#include <inttypes.h>
+#include <deque>
+#include <vector>
+
+#include "global_types.h"
+
+/**
+ * Store buffer stats, kept per core
+*/
+typedef struct store_buffer_stats_t {
+    counter_t stores;           // stores that entered the buffer
+    counter_t coalesced;        // stores merged into the youngest entry
+    counter_t bus_saved;        // coalesced stores to a line another core touched since the entry's last store
+    counter_t forwarded;        // loads served entirely from the buffer
+    counter_t load_drains;      // loads that partly overlapped buffered stores and waited for them to drain
+    counter_t full_stalls;      // stores that found the buffer full and waited for the oldest entry to drain
+    counter_t drains;           // entries written to the cache
+    counter_t ordering_drains;  // entries drained early by a fence or atomic
+    counter_t drain_transactions; // drains that needed a bus transaction
+} store_buffer_stats_t;
+
+/**
+ * Per-core FIFO of stores waiting to be written to the cache. Each entry holds the
+ * bytes written to one line. Under TSO a store may only merge into the youngest
+ * entry, so entries drain in program order and other cores never see a younger
+ * store before an older one. System decides when entries drain.
+ */
+class StoreBuffer {
+    public:
+        typedef struct entry_t {
+            addr_t line_addr;
+            std::vector<uint8_t> data;      // line_size bytes
+            std::vector<uint8_t> written;   // 1 for each byte holding a buffered store
+            bool contended;                 // another core touched the line since this entry's last store
+        } entry_t;
+
+        // Result of looking up a load in the buffer
+        typedef enum {
+            FORWARD_NONE = 0,   // no buffered bytes overlap the load
+            FORWARD_ALL,        // every byte of the load came from the buffer
+            FORWARD_PARTIAL     // some bytes overlap, the load has to wait for them to drain
+        } forward_t;
+
+    private:
+        unsigned int depth;             // entries
+        unsigned int line_size;
+        unsigned int drain_interval;    // accesses by the core between drains of the oldest entry
+        unsigned int ticks;
+        std::deque<entry_t> entries;    // oldest first
+
+        addr_t line_addr(addr_t physical_addr) { return physical_addr & ~((addr_t) line_size - 1); }
+
+    public:
+        store_buffer_stats_t stats;
+
+        void init(unsigned int depth, unsigned int line_size, unsigned int drain_interval);
+        bool empty() { return entries.empty(); }
+        bool full() { return entries.size() >= depth; }
+        // Called once per access by the core; true when the oldest entry is due to drain
+        bool tick();
+        // Buffer a store of size bytes within one line. Returns false if it needs a new entry and the buffer is full.
+        bool store(addr_t physical_addr, const uint8_t* data, unsigned int size);
+        // Look up a load within one line, filling data if every byte is buffered
+        forward_t forward(addr_t physical_addr, uint8_t* data, unsigned int size);
+        // Another core accessed the line holding physical_addr in its cache
+        void note_remote_access(addr_t physical_addr);
+        entry_t& oldest() { return entries.front(); }
+        void pop() { entries.pop_front(); }
+        // Number of entries, oldest first, that must drain before a load of these bytes can go to the cache
+        unsigned int drains_needed(addr_t physical_addr, unsigned int size);
+};
+
+#endif
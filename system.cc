@@ -4,83 +4,496 @@
 #include <iostream>
 
 #include "system.h"
+#include "instrument.h"
 
-void System::init(unsigned int _num_caches, protocol_t _protocol, Cache::config_t cache_config, unsigned int mem_size, unsigned int _bus_width){
-    this->protocol = _protocol;
-    this->num_caches = _num_caches;
-    this->bus_width = _bus_width;
+void System::init(const system_config_t& config){
+    this->protocol = config.protocol;
+    this->num_caches = config.num_cores;
+    this->bus_width = config.bus_width;
+    this->line_size = config.caches[0].line_size; // the same for every core
+    this->topology = config.topology;
+    cores_per_socket = num_caches / topology.sockets;
+    socket_mem_size = config.mem_size / topology.sockets;
+    memset(&link_stats, 0, sizeof(link_stats));
     invalidations = 0;
     data_bus_transactions = 0;
+    split_accesses = 0;
+    memset(&bus_stats, 0, sizeof(bus_stats));
+    memset(&atomic_stats, 0, sizeof(atomic_stats));
+    profiler = NULL;
+    snoop_filter = NULL;
+    store_buffers = NULL;
+    checker = NULL;
+    cache_locks = NULL;
+    verbose = false;
+    event_callback = NULL;
+    event_user_data = NULL;
     pthread_mutex_init(&bus_mutex, NULL);
 
-    bus.message = NONE;
-    bus.data = new uint8_t[cache_config.line_size];
-
-    shared_mem = new Memory();
-    shared_mem->init(mem_size, cache_config.line_size, &bus);
+    has_dram = config.dram.channels > 0;
+    timed = has_dram || topology.sockets > 1 || config.llc.size > 0;
+    cache_to_cache_latency = config.dram.cache_to_cache;
+    llc_hit_time = config.llc.hit_time;
+    llc_victim = new uint8_t[line_size];
+    sockets = new socket_t[topology.sockets];
+    for (unsigned int i = 0; i < topology.sockets; i++) {
+        sockets[i].bus.message = NONE;
+        sockets[i].bus.data = new uint8_t[line_size];
+        sockets[i].bus.evicted = false;
+        sockets[i].bus.evicted_dirty = false;
+        sockets[i].memory.init((unsigned int) socket_mem_size, line_size);
+        if (has_dram) sockets[i].memory.enable_dram(config.dram);
+        sockets[i].llc = config.llc.size > 0 ? new LastLevelCache(config.llc, line_size) : NULL;
+        sockets[i].bus_now = 0;
+        sockets[i].bus_free = 0;
+        memset(&sockets[i].stats, 0, sizeof(socket_stats_t));
+    }
 
     caches = new Cache[num_caches];
     for (unsigned int i = 0; i < num_caches; i++) {
-        caches[i].init(cache_config, protocol, &bus);
+        caches[i].init(config.caches[i], protocol, &sockets[socket_of(i)].bus);
+        if (timed) caches[i].measure_misses();
+    }
+    if (config.store_buffer_entries > 0) {
+        enable_store_buffers(config.store_buffer_entries, config.drain_interval);
+    }
+}
+
+counter_t System::memory_access(unsigned int socket, addr_t physical_addr, access_t access_type, uint8_t* data, counter_t now) {
+    unsigned int home = home_socket(physical_addr);
+    counter_t link_cycles = 0;
+    if (home == socket) {
+        sockets[socket].stats.local_mem++;
+    } else {
+        sockets[socket].stats.remote_mem++;
+        link_stats.transfers++;
+        link_cycles = link_crossing(line_size);
+    }
+    // addresses past the end of memory wrap around
+    counter_t latency = sockets[home].memory.access(physical_addr % socket_mem_size, access_type, data, now);
+    if (!timed) return 0;
+    // a remote line also crosses the home socket's bus, on its way to or from the link
+    if (home != socket) latency += bus_transfer(home, now + latency) + link_cycles;
+    return latency;
+}
+
+counter_t System::link_crossing(unsigned int bytes) {
+    counter_t cycles = topology.link_latency + (bytes + topology.link_bandwidth - 1) / topology.link_bandwidth;
+    link_stats.bytes += bytes;
+    link_stats.cycles += cycles;
+    return cycles;
+}
+
+counter_t System::bus_transfer(unsigned int socket, counter_t ready) {
+    socket_t* s = &sockets[socket];
+    // As in a DRAM channel, transfers are seen in trace order: one ready before the last transfer
+    // started (its core's clock lags) is treated as ready then
+    if (ready < s->bus_now) ready = s->bus_now;
+    counter_t start = ready > s->bus_free ? ready : s->bus_free;
+    counter_t cycles = (line_size + bus_width - 1) / bus_width;
+    s->bus_now = start;
+    s->bus_free = start + cycles;
+    s->stats.bus_busy += cycles;
+    s->stats.bus_wait += start - ready;
+    return start - ready;
+}
+
+counter_t System::fetch(unsigned int core, addr_t physical_addr, uint8_t* data, counter_t now) {
+    unsigned int socket = socket_of(core);
+    unsigned int home = home_socket(physical_addr);
+    LastLevelCache* llc = sockets[socket].llc;
+    if (llc) {
+        if (llc->read(physical_addr, data)) {
+            if (verbose) std::cout << "    DATA FROM LLC\n";
+            emit(EVENT_LLC_HIT, core, core, physical_addr);
+            return llc_hit_time;
+        }
+        if (home != socket && sockets[home].llc->read(physical_addr, data)) {
+            if (verbose) std::cout << "    DATA FROM HOME SOCKET'S LLC\n";
+            emit(EVENT_LLC_HIT, core, core, physical_addr);
+            sockets[socket].stats.remote_llc_hits++;
+            link_stats.transfers++;
+            counter_t latency = llc_hit_time;
+            latency += bus_transfer(home, now + latency) + link_crossing(line_size);
+            llc_write(socket, physical_addr, data, false, now);
+            return latency;
+        }
+    }
+    bus_stats.mem_fetches++;
+    emit(EVENT_MEMORY_FETCH, core, core, physical_addr);
+    counter_t latency = memory_access(socket, physical_addr, SEND, data, now);
+    if (timed && !has_dram) latency += (counter_t) caches[core].get_miss_penalty();
+    if (llc) llc_write(socket, physical_addr, data, false, now);
+    return latency;
+}
+
+void System::writeback(unsigned int socket, addr_t physical_addr, uint8_t* data, counter_t now) {
+    bool home = home_socket(physical_addr) == socket;
+    if (sockets[socket].llc) {
+        sockets[socket].llc->stats.writebacks++;
+        // lines homed in other sockets are kept clean, so their data goes on to memory too
+        llc_write(socket, physical_addr, data, home, now);
+        if (home) return;
+    }
+    memory_access(socket, physical_addr, STORE, data, now);
+}
+
+void System::llc_write(unsigned int socket, addr_t physical_addr, uint8_t* data, bool dirty, counter_t now) {
+    addr_t evicted_addr;
+    if (sockets[socket].llc->write(physical_addr, data, dirty, &evicted_addr, llc_victim)) {
+        // only lines of the socket's own memory are held dirty
+        memory_access(socket, evicted_addr, STORE, llc_victim, now);
+    }
+}
+
+uint64_t System::invalidate_llcs(unsigned int socket, addr_t physical_addr, counter_t now) {
+    uint64_t held = 0;
+    for (unsigned int i = 0; i < topology.sockets; i++) {
+        bool dirty;
+        if (i == socket || !sockets[i].llc->invalidate(physical_addr, &dirty, llc_victim)) continue;
+        held |= (uint64_t) 1 << i;
+        // a dirty copy is in its home socket's LLC, and goes to that socket's memory
+        if (dirty) memory_access(i, physical_addr, STORE, llc_victim, now);
+    }
+    return held;
+}
+
+bool System::enable_snoop_filter() {
+    // the filter's sharer masks have one bit per cache
+    if (num_caches > 64) return false;
+    if (!snoop_filter) snoop_filter = new SnoopFilter(line_size);
+    return true;
+}
+
+void System::set_verbose(bool verbose) {
+    this->verbose = verbose;
+    for (unsigned int i = 0; i < num_caches; i++) caches[i].set_verbose(verbose);
+    for (unsigned int i = 0; i < topology.sockets; i++) sockets[i].memory.set_verbose(verbose);
+}
+void System::set_event_callback(event_callback_t callback, void* user_data) {
+    pthread_mutex_lock(&bus_mutex);
+    event_callback = callback;
+    event_user_data = user_data;
+    pthread_mutex_unlock(&bus_mutex);
+}
+void System::enable_fast_path() {
+    cache_locks = new cache_lock_t[num_caches];
+    for (unsigned int i = 0; i < num_caches; i++) {
+        pthread_mutex_init(&cache_locks[i].mutex, NULL);
+        cache_locks[i].fast_hits = 0;
     }
 }
+void System::enable_checker() {
+    checker = new CoherenceChecker(line_size);
+}
+void System::check_line(addr_t physical_addr, int requester) {
+    line_copy_t* copies = new line_copy_t[num_caches];
+    bool* held = new bool[num_caches];
+    for (unsigned int i = 0; i < num_caches; i++) {
+        held[i] = caches[i].probe(physical_addr, &copies[i]);
+    }
+    unsigned int home = home_socket(physical_addr);
+    const uint8_t* memory = sockets[home].memory.line(physical_addr % socket_mem_size);
+    const uint8_t** llc_copies = new const uint8_t*[topology.sockets];
+    for (unsigned int i = 0; i < topology.sockets; i++) {
+        bool dirty = false;
+        llc_copies[i] = sockets[i].llc ? sockets[i].llc->probe(physical_addr, &dirty) : NULL;
+        // a dirty copy in the home socket's LLC is newer than memory
+        if (dirty) memory = llc_copies[i];
+    }
+    uint64_t filtered = snoop_filter ? snoop_filter->holders(physical_addr) : 0;
+    checker->check_line(physical_addr, requester, copies, held, num_caches, memory, llc_copies, topology.sockets,
+            snoop_filter ? &filtered : NULL);
+    delete [] copies;
+    delete [] held;
+    delete [] llc_copies;
+}
+void System::enable_profiler(unsigned int top_n) {
+    profiler = new SharingProfiler(num_caches, line_size, top_n);
+}
 
-uint8_t System::access(unsigned int core, addr_t physical_addr, access_t access_type, uint8_t data){
+void System::enable_store_buffers(unsigned int depth, unsigned int drain_interval) {
+    store_buffer_depth = depth;
+    store_buffer_drain_interval = drain_interval;
+    store_buffers = new StoreBuffer[num_caches];
+    for (unsigned int i = 0; i < num_caches; i++) {
+        store_buffers[i].init(depth, line_size, drain_interval);
+    }
+}
+
+void System::drain_store_buffers() {
+    if (!store_buffers) return;
     pthread_mutex_lock(&bus_mutex);
-    bus.addr = physical_addr;
-    uint8_t result_data = caches[core].try_access(physical_addr, access_type, data);
-    message_t message = bus.message;
+    for (unsigned int i = 0; i < num_caches; i++) {
+        while (!store_buffers[i].empty()) drain_store(i);
+    }
+    pthread_mutex_unlock(&bus_mutex);
+}
+
+void System::finish() {
+    drain_store_buffers();
+    pthread_mutex_lock(&bus_mutex);
+    for (unsigned int i = 0; i < topology.sockets; i++) sockets[i].memory.drain();
+    pthread_mutex_unlock(&bus_mutex);
+}
+
+bool System::fast_access(unsigned int core, addr_t physical_addr, access_t access_type, uint8_t* data, unsigned int size) {
+    if (profiler || store_buffers || checker) return false;
+    if (access_type != MEMREAD && access_type != IFETCH && access_type != MEMWRITE) return false;
+    if ((physical_addr & (line_size - 1)) + size > line_size) return false;
+    // Snoopers take this lock too, so the line can't change state or data while the hit is performed
+    pthread_mutex_lock(&cache_locks[core].mutex);
+    bool hit = caches[core].try_hit(physical_addr, access_type, data, size);
+    if (hit) cache_locks[core].fast_hits++;
+    pthread_mutex_unlock(&cache_locks[core].mutex);
+    return hit;
+}
+void System::access(unsigned int core, addr_t physical_addr, access_t access_type, uint8_t* data, unsigned int size){
+    if (cache_locks && fast_access(core, physical_addr, access_type, data, size)) return;
+    pthread_mutex_lock(&bus_mutex);
+    if (store_buffers && store_buffers[core].tick()) drain_store(core);
+    // Fences and atomics wait for the core's buffered stores, as on TSO machines
+    if (store_buffers && (access_type == FENCE || is_rmw(access_type))) {
+        while (!store_buffers[core].empty()) {
+            store_buffers[core].stats.ordering_drains++;
+            drain_store(core);
+        }
+    }
+    unsigned int offset = (unsigned int) (physical_addr & (line_size - 1));
+    if (access_type == FENCE) {
+        // Accesses are performed in order, so there is nothing else to wait for
+        atomic_stats.fences++;
+    } else if (offset + size <= line_size) {
+        message_t message = buffered_access(core, physical_addr, access_type, data, size);
+        if (is_rmw(access_type)) record_atomic(core, physical_addr, access_type, message, data, size);
+    } else {
+        // Straddles a line boundary: one operation per line, both under the same bus lock
+        unsigned int first_size = line_size - offset;
+        split_accesses++;
+        buffered_access(core, physical_addr, access_type, data, first_size);
+        buffered_access(core, physical_addr + first_size, access_type, data + first_size, size - first_size);
+    }
+    pthread_mutex_unlock(&bus_mutex);
+}
+
+message_t System::buffered_access(unsigned int core, addr_t physical_addr, access_t access_type, uint8_t* data, unsigned int size) {
+    if (!store_buffers || (access_type != MEMREAD && access_type != MEMWRITE)) {
+        return access_line(core, physical_addr, access_type, data, size);
+    }
+    StoreBuffer* store_buffer = &store_buffers[core];
+    if (access_type == MEMWRITE) {
+        if (!store_buffer->store(physical_addr, data, size)) {
+            // Buffer full: the core stalls until the oldest entry is written
+            store_buffer->stats.full_stalls++;
+            drain_store(core);
+            store_buffer->store(physical_addr, data, size);
+        }
+        return NONE;
+    }
+    StoreBuffer::forward_t forwarded = store_buffer->forward(physical_addr, data, size);
+    if (forwarded == StoreBuffer::FORWARD_ALL) {
+        store_buffer->stats.forwarded++;
+        return NONE;
+    }
+    if (forwarded == StoreBuffer::FORWARD_PARTIAL) {
+        // Can't combine buffered and cached bytes; wait for the overlapping stores to reach the cache
+        store_buffer->stats.load_drains++;
+        for (unsigned int n = store_buffer->drains_needed(physical_addr, size); n > 0; n--) {
+            drain_store(core);
+        }
+    }
+    return access_line(core, physical_addr, access_type, data, size);
+}
+
+void System::drain_store(unsigned int core) {
+    StoreBuffer* store_buffer = &store_buffers[core];
+    StoreBuffer::entry_t* entry = &store_buffer->oldest();
+    if (verbose) printf("    STORE BUFFER DRAIN core %u line 0x%.6llx\n", core, entry->line_addr);
+    store_buffer->stats.drains++;
+    bool transaction = false;
+    // one cache write per contiguous run of buffered bytes
+    for (unsigned int i = 0; i < line_size; ) {
+        if (!entry->written[i]) {
+            i++;
+            continue;
+        }
+        unsigned int start = i;
+        while (i < line_size && entry->written[i]) i++;
+        if (access_line(core, entry->line_addr + start, MEMWRITE, &entry->data[start], i - start) != NONE) transaction = true;
+    }
+    if (transaction) store_buffer->stats.drain_transactions++;
+    store_buffer->pop();
+}
+
+void System::record_atomic(unsigned int core, addr_t physical_addr, access_t access_type, message_t message, uint8_t* data, unsigned int size) {
+    if (access_type == ATOMIC_SWAP) atomic_stats.swaps++;
+    else if (access_type == ATOMIC_FETCH_ADD) atomic_stats.fetch_adds++;
+    else {
+        atomic_stats.cas++;
+        // data now holds the old value, still followed by the compare value
+        if (memcmp(data, data + size, size) != 0) atomic_stats.cas_failures++;
+    }
+    if (message == NONE) atomic_stats.exclusive_hits++;
+    else atomic_stats.contended++;
+
+    addr_t line_addr = physical_addr & ~((addr_t) line_size - 1);
+    std::unordered_map<addr_t, unsigned int>::iterator it = last_atomic_core.find(line_addr);
+    if (it == last_atomic_core.end()) {
+        last_atomic_core[line_addr] = core;
+    } else if (it->second != core) {
+        atomic_stats.ping_pongs++;
+        it->second = core;
+    }
+}
+
+message_t System::access_line(unsigned int core, addr_t physical_addr, access_t access_type, uint8_t* data, unsigned int size){
+    uint8_t operand[2 * MAX_RMW_SIZE > MAX_ACCESS_SIZE ? 2 * MAX_RMW_SIZE : MAX_ACCESS_SIZE];
+    if (checker) memcpy(operand, data, access_type == ATOMIC_CAS ? 2 * size : size);
+    unsigned int socket = socket_of(core);
+    bus_t* bus = &sockets[socket].bus;
+    bus->addr = physical_addr;
+    bus->evicted = false;
+    bus->evicted_dirty = false;
+    // Cache locks are held one at a time, only around calls into that cache
+    lock_cache(core);
+    caches[core].try_access(physical_addr, access_type, data, size);
+    counter_t now = caches[core].get_cycles();  // memory requests arrive at the core's clock
+    unlock_cache(core);
+    message_t message = bus->message;
+    INSTRUMENT_SCOPE_IF(PHASE_COHERENCE, message != NONE || bus->evicted);
+    if (store_buffers) {
+        for (unsigned int i = 0; i < num_caches; i++) {
+            if (i != core) store_buffers[i].note_remote_access(physical_addr);
+        }
+    }
+    uint64_t remote_sockets = 0; // sockets this transaction's coherence requests were forwarded to
+    // caches that may hold the line; only meaningful with a snoop filter, otherwise every cache is probed
+    uint64_t sharers = 0;
+    if (snoop_filter) {
+        if (bus->evicted) snoop_filter->remove(core, bus->evicted_addr);
+        if (message != NONE) sharers = snoop_filter->lookup(core, physical_addr, num_caches);
+    }
+    if (bus->evicted) emit(EVENT_EVICTION, core, core, bus->evicted_addr);
+    if (bus->evicted_dirty) {
+        emit(EVENT_WRITEBACK, core, core, bus->evicted_addr);
+        // The miss evicted a dirty block; its data is on the bus, write it back before the bus is reused
+        bus_stats.mem_writebacks++;
+        bus_stats.evict_writebacks++;
+        data_bus_transactions++;
+        sockets[socket].stats.bus_transactions++;
+        if (timed) bus_transfer(socket, now);
+        writeback(socket, bus->evicted_addr, bus->data, now);
+    }
+    bool exclusive = message == WRITE_MISS || message == INVALIDATE; // the requester ends up the only holder
     if (message == READ_MISS || message == WRITE_MISS) {
+        counter_t latency = 0;  // only used when timed
+        if (message == READ_MISS) bus_stats.read_misses++;
+        else bus_stats.write_misses++;
+        emit(message == READ_MISS ? EVENT_READ_MISS : EVENT_WRITE_MISS, core, core, physical_addr);
         bool sent_data_from_cache = false; // true if dirty copy of data in another cache
         bool valid_in_other_cache = false; // true if valid copy of data in another cache
         // request data from other caches first.
         for (unsigned int i = 0; i < num_caches; i++) {
-            if (i != core) {
+            if (i != core && (!snoop_filter || (sharers >> i & 1))) {
+                unsigned int other_socket = socket_of(i);
+                // a cache in another socket snoops the request on its own bus, through the link
+                bus_t* other_bus = &sockets[other_socket].bus;
+                if (other_socket != socket) {
+                    remote_sockets |= (uint64_t) 1 << other_socket;
+                    other_bus->message = message;
+                }
+                lock_cache(i);
                 sent_data_from_cache = caches[i].system_access(physical_addr, SEND);
                 if (!valid_in_other_cache) valid_in_other_cache = caches[i].check_valid(physical_addr);
+                unlock_cache(i);
+                if (other_socket != socket) other_bus->message = NONE;
                 if (sent_data_from_cache) {
                     // write back to mem while recent data is on bus
-                    shared_mem->access(physical_addr, STORE);
+                    bus_stats.cache_to_cache++;
+                    bus_stats.mem_writebacks++;
+                    emit(EVENT_CACHE_TO_CACHE, core, i, physical_addr);
+                    if (profiler) profiler->record_transfer(physical_addr);
+                    latency = has_dram ? cache_to_cache_latency : (counter_t) caches[core].get_miss_penalty();
+                    if (other_socket != socket) {
+                        sockets[socket].stats.remote_transfers++;
+                        link_stats.transfers++;
+                        if (timed) latency += bus_transfer(other_socket, now + latency);
+                        latency += link_crossing(line_size);
+                        memcpy(bus->data, other_bus->data, line_size);
+                    }
+                    writeback(other_socket, physical_addr, other_bus->data, now);
                     break;
                 }
             }
         }
-        // If none of the caches has a dirty copy, request data from memory
-        if (!sent_data_from_cache) {
-            shared_mem->access(physical_addr, SEND);
-        }
-        
+        // If none of the caches has a dirty copy, get it from the LLCs or memory
+        if (!sent_data_from_cache) latency = fetch(core, physical_addr, bus->data, now);
+        if (timed) latency += bus_transfer(socket, now + latency);
+
         // Update bus message
         if (!valid_in_other_cache && protocol == MESI && message == READ_MISS) {
-            bus.message = SET_EXCLUSIVE;
+            bus->message = SET_EXCLUSIVE;
+            exclusive = true;
         } else {
-            bus.message = NONE;
+            bus->message = NONE;
         }
 
         // Tell original requesting processor to store data into its cache
         data_bus_transactions++;        
+        sockets[socket].stats.bus_transactions++;
+        lock_cache(core);
         caches[core].system_access(physical_addr, STORE);
+        if (snoop_filter) snoop_filter->add(core, physical_addr);
+        bus->message = NONE;
 
-        // If the new block evicts an old block, writeback.
-        if (bus.message == WRITEBACK) {
-            data_bus_transactions++;
-            shared_mem->access(bus.addr, STORE);
-        }
-        bus.message = NONE;
-
-        result_data = caches[core].processor_access(physical_addr, access_type, data);
+        caches[core].processor_access(physical_addr, access_type, data, size);
+        if (timed) caches[core].add_miss_cycles(latency);
+        unlock_cache(core);
     } 
+    // Copies in other sockets' LLCs would be stale once the requester writes its copy
+    if (exclusive && topology.sockets > 1 && sockets[socket].llc) {
+        remote_sockets |= invalidate_llcs(socket, physical_addr, now);
+    }
+    // Record before invalidating others so this access counts towards the requester's epoch
+    if (profiler) profiler->record_access(core, physical_addr, access_type, size, message == READ_MISS || message == WRITE_MISS);
+    if (message == INVALIDATE) {
+        bus_stats.upgrades++;
+        emit(EVENT_UPGRADE, core, core, physical_addr);
+    }
     if (message == INVALIDATE || message == WRITE_MISS) {
         // invalidate others
         invalidations++;
         if (verbose) std::cout << "    INVALIDATION\n";
         for (unsigned int i = 0; i < num_caches; i++) {
-            if (i != core) caches[i].invalidate(physical_addr);
+            if (i == core || (snoop_filter && !(sharers >> i & 1))) continue;
+            if (socket_of(i) != socket) remote_sockets |= (uint64_t) 1 << socket_of(i);
+            lock_cache(i);
+            bool invalidated = caches[i].invalidate(physical_addr);
+            unlock_cache(i);
+            if (invalidated) {
+                if (snoop_filter) snoop_filter->remove(i, physical_addr);
+                bus_stats.invalidated_copies++;
+                if (socket_of(i) != socket) link_stats.invalidated_copies++;
+                if (profiler) profiler->record_invalidation(physical_addr, core, i);
+                emit(EVENT_INVALIDATION, core, i, physical_addr);
+            }
         }
-        bus.message = NONE;
+        bus->message = NONE;
     }
-    pthread_mutex_unlock(&bus_mutex);
-    return result_data;
+    // one request message per remote socket, covering both the data request and the invalidation
+    for (unsigned int i = 0; remote_sockets; i++, remote_sockets >>= 1) {
+        if (remote_sockets & 1) {
+            link_stats.messages++;
+            link_crossing(0);
+        }
+    }
+    if (checker) {
+        if (physical_addr >= socket_mem_size * topology.sockets) checker->note_wrapped_access();
+        checker->check_access(core, physical_addr, access_type, operand, data, size);
+        check_line(physical_addr, (int) core);
+        if (bus->evicted) check_line(bus->evicted_addr, -1);
+    }
+    return message;
 }
 
 void System::print_stats(){
@@ -89,14 +502,132 @@ void System::print_stats(){
         caches[i].print_stats();
     }
     std::cout << "========================== System Stats ===========================\n";
-    shared_mem->print_stats();
+    for (unsigned int i = 0; i < topology.sockets; i++) {
+        socket_stats_t* stats = &sockets[i].stats;
+        if (topology.sockets > 1) {
+            std::cout << "Socket " << i << " (cores " << i * cores_per_socket << "-" << (i + 1) * cores_per_socket - 1 << "):\n";
+        }
+        sockets[i].memory.print_stats();
+        if (sockets[i].llc) sockets[i].llc->print_stats();
+        if (topology.sockets > 1) {
+            printf("Bus data transactions: %llu\n"
+                    "Local memory accesses: %llu\n"
+                    "Remote memory accesses: %llu\n"
+                    "Lines received from caches in other sockets: %llu\n",
+                    stats->bus_transactions,
+                    stats->local_mem,
+                    stats->remote_mem,
+                    stats->remote_transfers);
+            if (sockets[i].llc) printf("Misses served by the home socket's LLC: %llu\n", stats->remote_llc_hits);
+        }
+        if (timed) printf("Bus busy cycles: %llu, cycles waited for the bus: %llu\n", stats->bus_busy, stats->bus_wait);
+    }
+    if (topology.sockets > 1) {
+        printf("Inter-socket link:\n"
+                "    Coherence requests forwarded: %llu\n"
+                "    Copies invalidated remotely: %llu\n"
+                "    Line transfers: %llu\n"
+                "    Bytes: %llu\n"
+                "    Busy cycles: %llu\n",
+                link_stats.messages,
+                link_stats.invalidated_copies,
+                link_stats.transfers,
+                link_stats.bytes,
+                link_stats.cycles);
+    }
     std::cout << "Invalidations: " << invalidations << "\n";
     std::cout << "Total data transactions through bus: "  << data_bus_transactions << "\n";
+    std::cout << "Line-crossing accesses: " << split_accesses << "\n";
+    printf("Bus messages:\n"
+            "    READ_MISS: %llu\n"
+            "    WRITE_MISS: %llu\n"
+            "    INVALIDATE (upgrades): %llu\n"
+            "Copies invalidated in other caches: %llu\n"
+            "Cache-to-cache transfers: %llu\n"
+            "Memory fetches: %llu\n"
+            "Memory writebacks: %llu (evictions: %llu)\n",
+            bus_stats.read_misses,
+            bus_stats.write_misses,
+            bus_stats.upgrades,
+            bus_stats.invalidated_copies,
+            bus_stats.cache_to_cache,
+            bus_stats.mem_fetches,
+            bus_stats.mem_writebacks, bus_stats.evict_writebacks);
+    printf("Atomics: %llu (swap: %llu, fetch-add: %llu, CAS: %llu, failed CAS: %llu)\n"
+            "    Held exclusively: %llu\n"
+            "    Contended (bus transaction): %llu\n"
+            "    Line ping-pong between cores: %llu\n"
+            "Fences: %llu\n",
+            atomic_stats.swaps + atomic_stats.fetch_adds + atomic_stats.cas,
+            atomic_stats.swaps, atomic_stats.fetch_adds, atomic_stats.cas, atomic_stats.cas_failures,
+            atomic_stats.exclusive_hits,
+            atomic_stats.contended,
+            atomic_stats.ping_pongs,
+            atomic_stats.fences);
+    if (store_buffers) {
+        store_buffer_stats_t total;
+        memset(&total, 0, sizeof(total));
+        for (unsigned int i = 0; i < num_caches; i++) {
+            store_buffer_stats_t* core_stats = &store_buffers[i].stats;
+            total.stores += core_stats->stores;
+            total.coalesced += core_stats->coalesced;
+            total.bus_saved += core_stats->bus_saved;
+            total.forwarded += core_stats->forwarded;
+            total.load_drains += core_stats->load_drains;
+            total.full_stalls += core_stats->full_stalls;
+            total.drains += core_stats->drains;
+            total.ordering_drains += core_stats->ordering_drains;
+            total.drain_transactions += core_stats->drain_transactions;
+        }
+        printf("Store buffers: %u entries per core, oldest drains every %u accesses\n"
+                "    Stores: %llu\n"
+                "    Coalesced: %llu (%f%%)\n"
+                "    Bus transactions saved (coalesced stores to a line another core touched): %llu\n"
+                "    Loads forwarded from the buffer: %llu\n"
+                "    Loads waiting for overlapping stores to drain: %llu\n"
+                "    Full-buffer stalls: %llu\n"
+                "    Entries drained: %llu (by fences/atomics: %llu)\n"
+                "    Drains needing a bus transaction: %llu\n",
+                store_buffer_depth, store_buffer_drain_interval,
+                total.stores,
+                total.coalesced, total.stores ? (100.0 * total.coalesced) / total.stores : 0.0,
+                total.bus_saved,
+                total.forwarded,
+                total.load_drains,
+                total.full_stalls,
+                total.drains, total.ordering_drains,
+                total.drain_transactions);
+    }
+    if (cache_locks) {
+        counter_t fast_hits = 0;
+        counter_t accesses = 0;
+        for (unsigned int i = 0; i < num_caches; i++) {
+            fast_hits += cache_locks[i].fast_hits;
+            accesses += caches[i].get_stats()->accesses;
+        }
+        printf("Fast-path hits (bus lock skipped): %llu (%f%% of cache accesses)\n",
+                fast_hits, accesses ? (100.0 * fast_hits) / accesses : 0.0);
+    }
+    if (snoop_filter) snoop_filter->print_stats();
+    if (profiler) profiler->print_stats();
+    if (checker) checker->print_stats();
 }
 
 System::~System() {
+    delete profiler;
+    delete snoop_filter;
+    delete checker;
+    if (cache_locks) {
+        for (unsigned int i = 0; i < num_caches; i++) pthread_mutex_destroy(&cache_locks[i].mutex);
+        delete [] cache_locks;
+    }
+    delete [] store_buffers;
     delete [] caches;
-    delete shared_mem;
-    delete [] bus.data;
+    for (unsigned int i = 0; i < topology.sockets; i++) {
+        delete sockets[i].llc;
+        delete [] sockets[i].bus.data;
+    }
+    delete [] sockets;
+    delete [] llc_victim;
     pthread_mutex_destroy(&bus_mutex);
 }
\ No newline at end of file
@@ -1,24 +1,248 @@
 #ifndef __SYSTEM_H
 #define __SYSTEM_H
 
+#include <vector>
+
 #include "cache.h"
+#include "checker.h"
+#include "dram.h"
+#include "llc.h"
 #include "memory.h"
+#include "profiler.h"
+#include "snoop_filter.h"
+#include "store_buffer.h"
+
+/**
+ * Bus traffic broken down by message type
+*/
+typedef struct bus_stats_t {
+    counter_t read_misses;          // READ_MISS messages
+    counter_t write_misses;         // WRITE_MISS messages
+    counter_t upgrades;             // INVALIDATE messages (write to a shared line, no data needed)
+    counter_t invalidated_copies;   // copies actually invalidated in other caches
+    counter_t cache_to_cache;       // misses supplied by another cache
+    counter_t mem_fetches;          // misses supplied by memory
+    counter_t mem_writebacks;       // dirty lines written to memory, either flushed on a transfer or evicted
+    counter_t evict_writebacks;     // subset of mem_writebacks caused by evictions
+} bus_stats_t;
+
+/**
+ * Atomic read-modify-write and fence stats
+*/
+typedef struct atomic_stats_t {
+    counter_t swaps;
+    counter_t fetch_adds;
+    counter_t cas;
+    counter_t cas_failures;
+    counter_t exclusive_hits;   // line already held in MODIFIED/EXCLUSIVE, no bus transaction
+    counter_t contended;        // needed a bus transaction to get the line
+    counter_t ping_pongs;       // line last updated atomically by a different core
+    counter_t fences;
+} atomic_stats_t;
+
+/**
+ * Grouping of cores into sockets. Each socket has its own bus, an optional shared LLC and
+ * a slice of memory, and sockets are connected by a point-to-point link.
+*/
+typedef struct topology_t {
+    unsigned int sockets;
+    unsigned int link_latency;      // cycles for a message to cross the inter-socket link
+    unsigned int link_bandwidth;    // bytes per cycle on the inter-socket link
+} topology_t;
+
+/**
+ * Per-socket NUMA stats
+*/
+typedef struct socket_stats_t {
+    counter_t bus_transactions;     // data transactions by this socket's cores on its bus
+    counter_t bus_busy;             // cycles the bus carried data, counting other sockets' transfers too
+    counter_t bus_wait;             // cycles transfers waited for the bus to be free
+    counter_t local_mem;            // memory accesses by this socket's cores to its own memory
+    counter_t remote_mem;           // memory accesses by this socket's cores to another socket's memory
+    counter_t remote_transfers;     // lines this socket's cores got from a cache in another socket
+    counter_t remote_llc_hits;      // misses of this socket's cores served by the home socket's LLC
+} socket_stats_t;
+
+/**
+ * A socket: its cores' caches and its memory slice sit on its bus
+*/
+typedef struct socket_t {
+    bus_t bus;
+    Memory memory;
+    LastLevelCache* llc;            // NULL without an LLC
+    counter_t bus_now;              // when the bus's last transfer started
+    counter_t bus_free;             // when the bus is next free
+    socket_stats_t stats;
+} socket_t;
+
+/**
+ * Inter-socket link stats
+*/
+typedef struct link_stats_t {
+    counter_t messages;             // coherence requests (snoops, invalidations) forwarded to another socket
+    counter_t transfers;            // lines sent across the link
+    counter_t invalidated_copies;   // copies invalidated in another socket
+    counter_t bytes;
+    counter_t cycles;               // link_latency + bytes / link_bandwidth per crossing
+} link_stats_t;
 
+/**
+ * Everything System::init needs; see config.h for loading it from a file
+*/
+typedef struct system_config_t {
+    unsigned int num_cores;
+    protocol_t protocol;
+    std::vector<Cache::config_t> caches;    // one per core
+    unsigned int mem_size;
+    unsigned int bus_width;
+    topology_t topology;
+    llc_config_t llc;                       // llc.size 0 for no LLC
+    unsigned int store_buffer_entries;      // 0 for no store buffers
+    unsigned int drain_interval;
+    dram_config_t dram;                     // dram.channels 0 for a fixed miss_penalty per miss
+} system_config_t;
+
+/**
+ * Coherence events reported to the callback set with System::set_event_callback
+*/
+typedef enum {
+    EVENT_READ_MISS = 0,    // core put READ_MISS on the bus
+    EVENT_WRITE_MISS,       // core put WRITE_MISS on the bus
+    EVENT_UPGRADE,          // core wrote a SHARED line and put INVALIDATE on the bus
+    EVENT_CACHE_TO_CACHE,   // other supplied the line to core
+    EVENT_MEMORY_FETCH,     // the line core missed on came from memory
+    EVENT_INVALIDATION,     // core's request invalidated other's copy
+    EVENT_EVICTION,         // core evicted the line to make room for a miss
+    EVENT_WRITEBACK,        // the line core evicted was dirty and written back to memory (or its socket's LLC)
+    EVENT_LLC_HIT           // the line core missed on came from an LLC: its socket's, or the home socket's
+} event_type_t;
+
+typedef struct coherence_event_t {
+    event_type_t type;
+    unsigned int core;      // core whose access caused the event
+    unsigned int other;     // the other cache involved (supplier or invalidated copy), otherwise core
+    addr_t address;         // line address
+} coherence_event_t;
+
+// Called during System::access with the bus lock held, so it must not call back into the System
+typedef void (*event_callback_t)(const coherence_event_t* event, void* user_data);
+
+/**
+ * Lock for one cache, taken by its core's fast-path hits and by anyone else touching the cache.
+ * On its own line so cores taking their own locks don't false share.
+*/
+typedef struct alignas(64) cache_lock_t {
+    pthread_mutex_t mutex;
+    counter_t fast_hits;    // accesses served without the bus lock
+} cache_lock_t;
 
 class System {
     private:
         Cache* caches;      // Array of caches, one for each core
-        Memory* shared_mem; // Main memory, shared by all cores
-        bus_t bus;
-        unsigned int bus_width;      // Width of system bus; amount of data that can be transferred per usage of bus
+        socket_t* sockets;  // One per socket, each with its bus, LLC and memory slice
+        unsigned int bus_width;      // Width of each socket's bus; bytes transferred per cycle
         unsigned int num_caches;     // Number of caches/cores
         protocol_t protocol;       // Cache coherence protocol. See the definition for protocol_t.
+        // Serializes transactions, whichever socket's bus they are on: the simulator performs one at a
+        // time. Contention between them is modeled in cycles, see bus_transfer.
         pthread_mutex_t bus_mutex;
+        cache_lock_t* cache_locks;  // One per cache, NULL unless the fast path is enabled
         counter_t invalidations;
         counter_t data_bus_transactions;
+        counter_t split_accesses;   // accesses that straddled two lines
+        bus_stats_t bus_stats;
+        atomic_stats_t atomic_stats;
+        std::unordered_map<addr_t, unsigned int> last_atomic_core; // line address -> core of its last atomic
+        SharingProfiler* profiler; // NULL unless line profiling is enabled
+        SnoopFilter* snoop_filter; // NULL when every miss and invalidation is broadcast to all caches
+        StoreBuffer* store_buffers; // One per core, NULL when stores go straight to the cache
+        CoherenceChecker* checker;  // NULL unless coherence checking is enabled
+        unsigned int store_buffer_depth;
+        unsigned int store_buffer_drain_interval;
+        unsigned int line_size;
+        topology_t topology;
+        unsigned int cores_per_socket;
+        addr_t socket_mem_size;
+        link_stats_t link_stats;
+        // Misses are charged the cycles they took (see access_line) instead of a flat miss_penalty. On
+        // with DRAM, more than one socket, or LLCs.
+        bool timed;
+        bool has_dram;      // memory is timed by a DRAM model, otherwise it costs the core's miss_penalty
+        unsigned int cache_to_cache_latency;    // with DRAM; without, a transfer costs miss_penalty
+        unsigned int llc_hit_time;
+        uint8_t* llc_victim;    // a dirty line leaving an LLC
+        bool verbose;       // print bus activity
+        event_callback_t event_callback;    // NULL if nobody is listening
+        void* event_user_data;
+
+        void emit(event_type_t type, unsigned int core, unsigned int other, addr_t physical_addr) {
+            if (!event_callback) return;
+            coherence_event_t event = {type, core, other, physical_addr & ~((addr_t) line_size - 1)};
+            event_callback(&event, event_user_data);
+        }
+
+        void lock_cache(unsigned int i) { if (cache_locks) pthread_mutex_lock(&cache_locks[i].mutex); }
+        void unlock_cache(unsigned int i) { if (cache_locks) pthread_mutex_unlock(&cache_locks[i].mutex); }
+        // Serve the access from the core's own cache if it hits and needs no bus action
+        bool fast_access(unsigned int core, addr_t physical_addr, access_t access_type, uint8_t* data, unsigned int size);
+        unsigned int socket_of(unsigned int core) { return core / cores_per_socket; }
+        unsigned int home_socket(addr_t physical_addr) { return (unsigned int) ((physical_addr / socket_mem_size) % topology.sockets); }
+        // Memory access at cycle now for a line whose data comes from or goes to socket. Returns the
+        // cycles until the data arrives, including the home socket's bus and the link crossing if it's
+        // remote (0 if not timed).
+        counter_t memory_access(unsigned int socket, addr_t physical_addr, access_t access_type, uint8_t* data, counter_t now);
+        // Returns the crossing's cycles
+        counter_t link_crossing(unsigned int bytes);
+        // A line transfer on socket's bus, ready to go at cycle ready. Returns the cycles it waited for the bus.
+        counter_t bus_transfer(unsigned int socket, counter_t ready);
+        // Get the line a core missed on from below the private caches: its socket's LLC, the home
+        // socket's LLC, or memory. Fills data and returns the cycles it took (if timed).
+        counter_t fetch(unsigned int core, addr_t physical_addr, uint8_t* data, counter_t now);
+        // A private cache in socket wrote a dirty line back: into the socket's LLC, and on to memory
+        // unless the LLC can hold it dirty
+        void writeback(unsigned int socket, addr_t physical_addr, uint8_t* data, counter_t now);
+        void llc_write(unsigned int socket, addr_t physical_addr, uint8_t* data, bool dirty, counter_t now);
+        // Drop other sockets' LLC copies of a line core now holds exclusively; returns the sockets that had one
+        uint64_t invalidate_llcs(unsigned int socket, addr_t physical_addr, counter_t now);
+
+        // Access within a single line, returns the bus message it caused. Caller holds bus_mutex.
+        message_t access_line(unsigned int core, addr_t physical_addr, access_t access_type, uint8_t* data, unsigned int size);
+        // Access within a single line, through the core's store buffer if there is one
+        message_t buffered_access(unsigned int core, addr_t physical_addr, access_t access_type, uint8_t* data, unsigned int size);
+        // Write the oldest entry of the core's store buffer to its cache
+        void drain_store(unsigned int core);
+        // Hand every cache's copy of the line to the checker
+        void check_line(addr_t physical_addr, int requester);
+        void record_atomic(unsigned int core, addr_t physical_addr, access_t access_type, message_t message, uint8_t* data, unsigned int size);
     public:
-        void init(unsigned int _num_caches, protocol_t _protocol, Cache::config_t cache_config, unsigned int mem_size, unsigned int _bus_width);
-        uint8_t access(unsigned int core, addr_t physical_addr, access_t access_type, uint8_t data);
+        void init(const system_config_t& config);
+        void set_verbose(bool verbose);
+        // Report coherence events to callback, with user_data passed through. NULL stops reporting.
+        void set_event_callback(event_callback_t callback, void* user_data);
+        void enable_profiler(unsigned int top_n);
+        // Probe only the caches a snoop filter lists, instead of broadcasting every miss and invalidation.
+        // Call before the first access. Returns false if there are more caches than the filter supports.
+        bool enable_snoop_filter();
+        // Let private hits skip the bus lock, for parallel simulation. Only used when no profiler, store
+        // buffers or checker need to see every access.
+        void enable_fast_path();
+        // Check coherence invariants and data values after every access; see checker.h
+        void enable_checker();
+        counter_t coherence_violations() { return checker ? checker->get_violations() : 0; }
+        // Buffer each core's stores in a store buffer of depth entries, draining the oldest every drain_interval accesses
+        void enable_store_buffers(unsigned int depth, unsigned int drain_interval);
+        // Write out everything still in the store buffers, e.g. at the end of the trace
+        void drain_store_buffers();
+        // End of the run: drain the store buffers, then the writes queued in DRAM
+        void finish();
+        // Access size bytes starting at physical_addr (at most one line, may cross a line boundary).
+        // Reads fill data, writes store it. Atomics (which must not cross a line) take their operands in
+        // data and return the old value; the whole read-modify-write is one bus transaction.
+        void access(unsigned int core, addr_t physical_addr, access_t access_type, uint8_t* data, unsigned int size);
+        stats_t* get_cache_stats(unsigned int core) { return caches[core].get_stats(); }
+        const bus_stats_t& get_bus_stats() { return bus_stats; }
+        counter_t get_invalidations() { return invalidations; }
+        counter_t get_data_bus_transactions() { return data_bus_transactions; }
         void print_stats();
         ~System();
 };
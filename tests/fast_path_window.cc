@@ -0,0 +1,77 @@
+// Checks for Cache::try_hit, run by `make test`.
+//
+// In -p mode a hit takes only its own cache's lock. Another core's miss snoops the line with SEND,
+// which can leave a clean copy INVALID while it is still valid; the requester's invalidation loop
+// clears it later, under the bus lock. A hit in that window must fall back to the slow path, and no
+// hit may write to the bus, since the fast path doesn't hold bus_mutex.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cache.h"
+
+#define LINE 0x1000
+
+static int failures = 0;
+
+static void check(bool ok, const char* protocol, const char* what) {
+    if (!ok) {
+        printf("FAIL %s: %s\n", protocol, what);
+        failures++;
+    }
+}
+
+// Read miss, then fill with the reply message the system would put on the bus
+static void fill(Cache* cache, bus_t* bus, message_t reply) {
+    uint8_t data[4];
+    bus->message = NONE;
+    cache->try_access(LINE, MEMREAD, data, sizeof(data));
+    bus->message = reply;
+    cache->system_access(LINE, STORE);
+    bus->message = NONE;
+}
+
+static void run(protocol_t protocol, const char* name) {
+    Cache::config_t config = {64, 1024, 2, 1, 100, L1, 0};
+    uint8_t line[64] = {0};
+    bus_t bus;
+    memset(&bus, 0, sizeof(bus));
+    bus.data = line;
+    uint8_t data[4] = {1, 2, 3, 4};
+
+    // A SHARED copy snooped by another core's write miss: INVALID, still valid
+    Cache cache;
+    cache.init(config, protocol, &bus);
+    fill(&cache, &bus, NONE);
+    check(cache.try_hit(LINE, MEMREAD, data, sizeof(data)), name, "read of a SHARED line misses");
+    bus.message = WRITE_MISS;
+    check(!cache.system_access(LINE, SEND), name, "a clean copy sent data");
+    check(cache.check_valid(LINE), name, "SEND cleared valid; the window is gone");
+    counter_t accesses = cache.get_stats()->accesses;
+    check(!cache.try_hit(LINE, MEMREAD, data, sizeof(data)), name, "read hit an INVALID copy");
+    check(!cache.try_hit(LINE, IFETCH, data, sizeof(data)), name, "fetch hit an INVALID copy");
+    check(!cache.try_hit(LINE, MEMWRITE, data, sizeof(data)), name, "write hit an INVALID copy");
+    check(bus.message == WRITE_MISS, name, "a failed hit changed the bus message");
+    check(cache.get_stats()->accesses == accesses, name, "a failed hit was counted");
+
+    if (protocol == MESI) {
+        // Silent upgrade: EXCLUSIVE -> MODIFIED without a bus message
+        Cache exclusive;
+        exclusive.init(config, protocol, &bus);
+        fill(&exclusive, &bus, SET_EXCLUSIVE);
+        bus.message = READ_MISS; // stands for a transaction this cache must not disturb
+        check(exclusive.try_hit(LINE, MEMWRITE, data, sizeof(data)), name, "write to an EXCLUSIVE line misses");
+        check(bus.message == READ_MISS, name, "a write hit changed the bus message");
+        line_copy_t copy;
+        check(exclusive.probe(LINE, &copy) && copy.state == MODIFIED, name, "write hit left the line unmodified");
+        bus.message = NONE;
+    }
+}
+
+int main() {
+    run(MSI, "MSI");
+    run(MESI, "MESI");
+    if (failures) return 1;
+    printf("fast path window: ok\n");
+    return 0;
+}
@@ -0,0 +1,85 @@
+#!/bin/bash
+# Regression tests, run by `make test`. Every run simulates a trace from tests/traces with the
+# coherence checker (-c) on, and its final stats are compared with outputs/tests/<run>.txt.
+#
+# Usage: tests/run_tests.sh <simulator> [-u]
+#   -u : rewrite the baselines from this build instead of comparing (after an intended change)
+
+cd "$(dirname "$0")/.." || exit 1
+SIMULATOR=$1
+UPDATE=$2
+BASELINES=outputs/tests
+CONFIG=tests/test.ini
+SHARED=tests/traces/shared.trace
+PRIVATE="tests/traces/private.0.trace tests/traces/private.1.trace tests/traces/private.2.trace tests/traces/private.3.trace"
+
+if [ ! -x "$SIMULATOR" ]; then
+    echo "usage: $0 <simulator> [-u]"
+    exit 1
+fi
+mkdir -p $BASELINES
+
+# Features, as simulator options. -p runs use private per-core traces, so their stats don't
+# depend on how the threads interleave. Timing does (DRAM, and the buses and link of several
+# sockets), so those features only run with -s.
+FEATURES=(
+    "base|"
+    "snoop_filter|-f"
+    "victim|-o cache.victim_entries=4"
+    "store_buffer|-o store_buffer.entries=4"
+    "sockets|-o system.sockets=2 system.link_latency=20 system.link_bandwidth=16"
+    "llc|-o system.sockets=2 system.link_latency=20 system.link_bandwidth=16 llc.size=4096 llc.associativity=4"
+    "dram|-o dram.channels=2"
+)
+
+passed=0
+failed=0
+
+# Stats from the first cache report on, without the lines that vary from run to run
+stats() {
+    sed -n '/Cache Stats/,$p' | grep -v -e 'accesses/sec' -e 'Simulation Completed'
+}
+
+# run <name> <simulator arguments...>
+run() {
+    local name=$1
+    shift
+    local output
+    output=$("$SIMULATOR" $CONFIG "$@" 2>&1)
+    local status=$?
+    local baseline=$BASELINES/$name.txt
+    if [ $status -ne 0 ]; then
+        echo "FAIL $name: exit status $status"
+        echo "$output" | grep -m 5 -i -e violation -e error
+        failed=$((failed + 1))
+    elif [ "$UPDATE" = "-u" ]; then
+        echo "$output" | stats > $baseline
+        passed=$((passed + 1))
+    elif [ ! -f $baseline ]; then
+        echo "FAIL $name: no baseline $baseline (run tests/run_tests.sh $SIMULATOR -u)"
+        failed=$((failed + 1))
+    elif ! diff -u $baseline <(echo "$output" | stats) > /tmp/csim_test_$$.diff; then
+        echo "FAIL $name: stats differ from $baseline"
+        head -20 /tmp/csim_test_$$.diff
+        failed=$((failed + 1))
+    else
+        passed=$((passed + 1))
+    fi
+    rm -f /tmp/csim_test_$$.diff
+}
+
+for protocol in msi mesi; do
+    for feature in "${FEATURES[@]}"; do
+        name=${feature%%|*}
+        options=${feature#*|}
+        run ${protocol}_s_$name -s $SHARED -c $options -o system.protocol=$protocol
+        if [ $name != dram ] && [ $name != sockets ] && [ $name != llc ]; then
+            run ${protocol}_p_$name -p $PRIVATE -c $options -o system.protocol=$protocol
+        fi
+    done
+    # -c turns off the fast path for private hits; cover it too
+    run ${protocol}_p_fast_path -p $PRIVATE -o system.protocol=$protocol
+done
+
+echo "$passed passed, $failed failed"
+[ $failed -eq 0 ]
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+
+#include "trace.h"
+#include "instrument.h"
+
+const char* access_error(unsigned int core, int type, addr_t address, unsigned int size, unsigned int num_cores, unsigned int line_size) {
+    if (core >= num_cores) {
+        return "No such core";
+    }
+    if (type < MEMREAD || type > FENCE) {
+        return "Unknown access type";
+    }
+    if (size == 0 || size > MAX_ACCESS_SIZE || size > line_size) {
+        return "Unsupported access size";
+    }
+    if (is_rmw((access_t) type) && (size > MAX_RMW_SIZE || (address & (line_size - 1)) + size > line_size)) {
+        return "Atomic access must be at most 8 bytes and within one line";
+    }
+    return NULL;
+}
+
+int decode_line(FILE* trace, trace_access_t* access, unsigned int num_cores, unsigned int line_size) {
+    INSTRUMENT_SCOPE(PHASE_DECODE);
+    char line[128];
+    if (!fgets(line, sizeof(line), trace)) {
+        return 0;
+    }
+    unsigned int core;
+    int type;
+    addr_t address = 0;
+    unsigned long long value = 0;
+    unsigned int size = 1;
+    unsigned long long compare = 0;
+    int fields = sscanf(line, "%u %d %llx %llx %u %llx", &core, &type, &address, &value, &size, &compare);
+    // fences are the only accesses without an address
+    if (fields < 2 || (fields < 3 && type != FENCE)) {
+        return -1; // blank or malformed line
+    }
+    const char* error = access_error(core, type, address, size, num_cores, line_size);
+    if (error) {
+        std::cerr << error << ", skipping: " << line;
+        return -1;
+    }
+    access_t t = (access_t) type;
+
+    access->core = core;
+    access->address = address;
+    access->type = t;
+    access->size = size;
+    // Trace value is little endian, repeated every 8 bytes for vector-width accesses
+    for (unsigned int i = 0; i < size; i++) {
+        access->expected[i] = (uint8_t) (value >> (8 * (i % 8)));
+    }
+    if (is_write(t)) {
+        memcpy(access->data, access->expected, size);
+        if (t == ATOMIC_CAS) {
+            for (unsigned int i = 0; i < size; i++) access->data[size + i] = (uint8_t) (compare >> (8 * i));
+        }
+    } else {
+        memset(access->data, 0, size);
+    }
+    return 1;
+}
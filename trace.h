@@ -0,0 +1,26 @@
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "global_types.h"
+
+// A decoded trace line
+typedef struct trace_access_t {
+    unsigned int core;
+    addr_t address;
+    access_t type;
+    unsigned int size;
+    uint8_t data[MAX_ACCESS_SIZE];      // write data, or read result; CAS adds its compare value after the new value
+    uint8_t expected[MAX_ACCESS_SIZE];  // value from the trace, for test mode
+} trace_access_t;
+
+// Why this access can't be simulated on num_cores cores with line_size-byte lines, or NULL if it can
+const char* access_error(unsigned int core, int type, addr_t address, unsigned int size, unsigned int num_cores, unsigned int line_size);
+
+// Read and decode the next trace line. Returns 1 for an access, -1 for a line that was
+// skipped (blank, malformed, or unsupported; reported on stderr), and 0 at end of file.
+int decode_line(FILE* trace, trace_access_t* access, unsigned int num_cores, unsigned int line_size);
+
+#endif